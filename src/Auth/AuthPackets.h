@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Define.h"
+#include "AuthCmd.h"
+#include "AuthResult.h"
+
+// Fixed layouts of the authserver responses, shared by AuthSession and AuthService
+
+#pragma pack(push, 1)
+
+struct LogonChallengeResponse_Header
+{
+    AuthCmd Opcode;
+    uint8 Unk;
+    AuthResult Result;
+};
+
+struct LogonChallengeResponse_Body
+{
+    uint8 B[32];
+    uint8 g_length;
+    uint8 g[1];
+    uint8 N_length;
+    uint8 N[32];
+    uint8 Salt[32];
+    uint8 CRCSalt[16];
+    uint8 SecurityFlags;
+};
+
+struct LogonProofResponse_Header
+{
+    AuthCmd Opcode;
+    AuthResult Result;
+};
+
+struct LogonProofResponse_Body
+{
+    uint8   M2[20];
+    uint32  Unk1;
+    uint32  Unk2;
+    uint16  Unk3;
+};
+
+struct RealmlistResponse_Header
+{
+    AuthCmd Opcode;
+    uint16 Length;
+    uint32 Unk;
+    uint16 Count;
+};
+
+#pragma pack(pop)
@@ -0,0 +1,592 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AuthService.h"
+#include "AuthSession.h"
+#include "AuthPackets.h"
+#include "Network/AsyncSocket.h"
+#include "Network/ByteReader.h"
+#include "Network/MessageBuffer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+using namespace std::chrono;
+
+static const uint32 WatchdogInterval = 100;             // Milliseconds
+
+// One login, driven by the resolver until it has the addresses, then by the I/O thread
+// of its socket. Only SRP6 runs on a worker.
+class AuthService::Connection : public AsyncSocket, public std::enable_shared_from_this<Connection>
+{
+    public:
+        Connection(AuthService* service, std::shared_ptr<Session> session);
+        ~Connection();
+
+        std::future<bool> GetFuture() { return promise_.get_future(); }
+        bool IsFinished() const { return finished_; }
+
+        // Caller: resolves the authserver, connecting continues on the resolver and I/O threads
+        void Start();
+
+        // True if resolving and connecting took longer than the timeouts of TCPSocket together
+        bool IsConnectExpired(steady_clock::time_point now) const;
+
+        // Worker: runs SRP6 on the challenge, the I/O thread sends the proof
+        void CalculateProof();
+
+        // Fails the login unless it is already done
+        void Abort() { Finish(false); }
+
+    protected:
+        void OnReadable() override;
+        void OnWritable() override;
+
+    private:
+        enum State
+        {
+            STATE_RESOLVING,                // Waiting for the resolver
+            STATE_CONNECTING,               // A non-blocking connect is in progress
+            STATE_CHALLENGE,                // Waiting for the logon challenge response
+            STATE_CALCULATING,              // SRP6 runs on a worker, input is only buffered
+            STATE_PROOF_READY,              // The worker is done, the proof is sent next
+            STATE_PROOF,                    // Waiting for the logon proof response
+            STATE_REALMLIST                 // Waiting for the realm list
+        };
+
+        // Returns false once the login is finished
+        bool ProcessInput();
+        bool Fail(AuthResult result);
+
+        void OnResolved(AddressList const& addresses);
+
+        // Tries the remaining addresses in order until a connect starts, fails the login if none is left
+        void ConnectNext();
+
+        // I/O thread: sends the logon challenge once the connect succeeded
+        void OnConnect();
+
+        // Queues what the socket doesn't take at once, false if the connection is lost
+        bool SendPacket(ByteBuffer& packet);
+        bool Flush();
+        void Finish(bool result);
+
+        template<typename T>
+        bool Peek(T& value)
+        {
+            if (buffer_.GetActiveSize() < sizeof(T))
+                return false;
+
+            std::memcpy(&value, buffer_.GetReadPointer(), sizeof(T));
+            return true;
+        }
+
+        AuthService* service_;
+        std::shared_ptr<Session> session_;
+        std::promise<bool> promise_;
+        std::atomic<bool> finished_;
+        std::atomic<State> state_;          // Publishes srp6_ between the worker and the I/O thread
+        steady_clock::time_point deadline_;
+
+        AddressList candidates_;
+        size_t nextCandidate_;
+
+        SRP6 srp6_;
+        LogonChallengeResponse_Body challenge_;
+        ByteBuffer proof_;
+        MessageBuffer buffer_;              // Grows to fit the realm list
+
+        std::vector<uint8> sendBuffer_;
+        size_t sendOffset_;                 // Bytes of sendBuffer_ already sent
+};
+
+AuthService::Connection::Connection(AuthService* service, std::shared_ptr<Session> session) :
+    service_(service), session_(session), finished_(false), state_(STATE_RESOLVING),
+    deadline_(steady_clock::now() + milliseconds(DEFAULT_RESOLVE_TIMEOUT + DEFAULT_CONNECT_TIMEOUT)), nextCandidate_(0), buffer_(0x1000), sendOffset_(0)
+{
+}
+
+AuthService::Connection::~Connection()
+{
+    // The I/O thread may still be finishing a callback that finished the login
+    AsyncSocket::Disconnect();
+}
+
+void AuthService::Connection::Start()
+{
+    std::string host, port;
+
+    if (!SplitAddress(session_->GetAuthenticationServerAddress(), host, port))
+    {
+        print("%s", "Couldn't connect to authserver.");
+        Finish(false);
+        return;
+    }
+
+    // The lookup may outlive the service, an abandoned login just drops the result
+    std::weak_ptr<Connection> connection = shared_from_this();
+
+    Resolver::instance()->Resolve(host, port, [connection](AddressList const& addresses) {
+        if (std::shared_ptr<Connection> self = connection.lock())
+            self->OnResolved(addresses);
+    });
+}
+
+bool AuthService::Connection::IsConnectExpired(steady_clock::time_point now) const
+{
+    State state = state_;
+    return (state == STATE_RESOLVING || state == STATE_CONNECTING) && now >= deadline_;
+}
+
+void AuthService::Connection::OnResolved(AddressList const& addresses)
+{
+    if (finished_)
+        return;
+
+    candidates_ = InterleaveFamilies(addresses);
+    state_ = STATE_CONNECTING;
+    ConnectNext();
+}
+
+void AuthService::Connection::ConnectNext()
+{
+    while (!finished_ && nextCandidate_ < candidates_.size())
+    {
+        if (BeginConnect(candidates_[nextCandidate_++]) && Attach())
+        {
+            // An abort that ran before the socket was attached didn't see it
+            if (finished_)
+                Disconnect();
+
+            return;
+        }
+
+        Disconnect();
+    }
+
+    if (!finished_)
+        print("%s", "Couldn't connect to authserver.");
+
+    Finish(false);
+}
+
+void AuthService::Connection::OnConnect()
+{
+    switch (FinishConnect())
+    {
+        case CONNECT_IN_PROGRESS:
+            return;
+        case CONNECT_FAILED:
+            ConnectNext();
+            return;
+        case CONNECT_SUCCEEDED:
+            break;
+    }
+
+    ByteBuffer packet;
+    AuthSession::BuildLogonChallenge(packet, *session_);
+
+    state_ = STATE_CHALLENGE;
+
+    if (!SendPacket(packet))
+        Finish(false);
+}
+
+void AuthService::Connection::CalculateProof()
+{
+    if (finished_)
+        return;
+
+    AuthSession::CalculateProof(srp6_, *session_, challenge_);
+    AuthSession::BuildLogonProof(proof_, srp6_);
+
+    // Only the I/O thread uses the socket once it is attached
+    state_ = STATE_PROOF_READY;
+    RequestRead();
+}
+
+bool AuthService::Connection::SendPacket(ByteBuffer& packet)
+{
+    sendBuffer_.insert(sendBuffer_.end(), packet.contents(), packet.contents() + packet.size());
+    return Flush();
+}
+
+bool AuthService::Connection::Flush()
+{
+    while (sendOffset_ < sendBuffer_.size())
+    {
+        int32 result = TrySend(&sendBuffer_[sendOffset_], uint32(sendBuffer_.size() - sendOffset_));
+
+        if (!result)
+        {
+            if (!IsConnected())
+                return false;
+
+            // Socket buffer is full, continue once it drains
+            RequestWrite();
+            return true;
+        }
+
+        sendOffset_ += result;
+    }
+
+    sendBuffer_.clear();
+    sendOffset_ = 0;
+    return true;
+}
+
+void AuthService::Connection::OnWritable()
+{
+    if (state_ == STATE_CONNECTING)
+    {
+        OnConnect();
+        return;
+    }
+
+    if (!Flush() && !finished_)
+    {
+        print("%s", "Lost connection to authserver.");
+        Finish(false);
+    }
+}
+
+void AuthService::Connection::OnReadable()
+{
+    // A failed connect is reported as readable
+    if (state_ == STATE_CONNECTING)
+    {
+        OnConnect();
+        return;
+    }
+
+    // Called without new data when the proof is ready
+    if (!ProcessInput())
+        return;
+
+    while (IsConnected())
+    {
+        buffer_.Normalize();
+
+        size_t space = buffer_.GetRemainingSpace();
+
+        if (!space)
+        {
+            error("%s", "The authserver sent more than expected!");
+            Finish(false);
+            return;
+        }
+
+        int32 result = TryRead(buffer_.GetWritePointer(), space);
+
+        if (!result)
+            break;
+
+        buffer_.WriteCompleted(result);
+
+        if (!ProcessInput())
+            return;
+
+        // A short read drained the socket, new data will raise another edge
+        if (size_t(result) < space)
+            break;
+    }
+
+    if (!IsConnected() && !finished_)
+    {
+        print("%s", "Lost connection to authserver.");
+        Finish(false);
+    }
+}
+
+bool AuthService::Connection::ProcessInput()
+{
+    while (true)
+    {
+        switch (state_)
+        {
+            case STATE_RESOLVING:
+            case STATE_CONNECTING:
+                return true;
+            case STATE_CHALLENGE:
+            {
+                LogonChallengeResponse_Header header;
+
+                if (!Peek(header))
+                    return true;
+
+                if (header.Result != WOW_SUCCESS)
+                    return Fail(header.Result);
+
+                if (buffer_.GetActiveSize() < sizeof(header) + sizeof(challenge_))
+                    return true;
+
+                buffer_.ReadCompleted(sizeof(header));
+                Peek(challenge_);
+                buffer_.ReadCompleted(sizeof(challenge_));
+
+                // TODO: Implement the PIN (0x01), matrix card (0x02) and authenticator token (0x04) security flags
+                if (challenge_.SecurityFlags)
+                {
+                    error("%s", "The authserver requires unsupported security flags!");
+                    Finish(false);
+                    return false;
+                }
+
+                state_ = STATE_CALCULATING;
+
+                std::shared_ptr<Connection> self = shared_from_this();
+                service_->Post([self]() { self->CalculateProof(); });
+                return true;
+            }
+            case STATE_CALCULATING:
+                return true;
+            case STATE_PROOF_READY:
+            {
+                if (!SendPacket(proof_))
+                {
+                    Finish(false);
+                    return false;
+                }
+
+                state_ = STATE_PROOF;
+                break;
+            }
+            case STATE_PROOF:
+            {
+                LogonProofResponse_Header header;
+
+                if (!Peek(header))
+                    return true;
+
+                if (header.Result != WOW_SUCCESS)
+                    return Fail(header.Result);
+
+                LogonProofResponse_Body body;
+
+                if (buffer_.GetActiveSize() < sizeof(header) + sizeof(body))
+                    return true;
+
+                buffer_.ReadCompleted(sizeof(header));
+                Peek(body);
+                buffer_.ReadCompleted(sizeof(body));
+
+                if (!srp6_.IsValidM2(body.M2, 20))
+                {
+                    error("%s", "The authserver sent an invalid proof!");
+                    Finish(false);
+                    return false;
+                }
+
+                ByteBuffer packet;
+                AuthSession::BuildRealmlistRequest(packet);
+
+                if (!SendPacket(packet))
+                {
+                    Finish(false);
+                    return false;
+                }
+
+                state_ = STATE_REALMLIST;
+                break;
+            }
+            case STATE_REALMLIST:
+            {
+                RealmlistResponse_Header header;
+
+                if (!Peek(header))
+                    return true;
+
+                if (header.Length < sizeof(header.Unk) + sizeof(header.Count) || !header.Count)
+                {
+                    error("%s", "There are no realms!");
+                    Finish(false);
+                    return false;
+                }
+
+                // Length counts from Unk on
+                size_t bodyLength = header.Length - sizeof(header.Unk) - sizeof(header.Count);
+
+                if (buffer_.GetActiveSize() < sizeof(header) + bodyLength)
+                {
+                    // A big list doesn't fit the initial buffer, make room for all of it
+                    if (buffer_.GetBufferSize() < sizeof(header) + bodyLength)
+                    {
+                        buffer_.Normalize();
+                        buffer_.Resize(sizeof(header) + bodyLength);
+                    }
+
+                    return true;
+                }
+
+                ByteReader reader(buffer_.GetReadPointer() + sizeof(header), bodyLength);
+                Finish(AuthSession::SelectRealm(*session_, header.Count, reader));
+                return false;
+            }
+        }
+    }
+}
+
+bool AuthService::Connection::Fail(AuthResult result)
+{
+    print("%s", "[Authentication failed!]");
+    print("%s", AuthSession::AuthResultToStr(result).c_str());
+    Finish(false);
+    return false;
+}
+
+void AuthService::Connection::Finish(bool result)
+{
+    if (finished_.exchange(true))
+        return;
+
+    Disconnect();
+    promise_.set_value(result);
+}
+
+AuthService::AuthService(uint32 workerCount) : stopping_(false)
+{
+    if (!workerCount)
+    {
+        uint32 maxWorkers = MAX_WORKERS;
+        workerCount = std::max(1u, std::min(std::thread::hardware_concurrency(), maxWorkers));
+    }
+
+    for (uint32 i = 0; i < workerCount; ++i)
+        workers_.push_back(std::thread(&AuthService::RunWorker, this));
+
+    watchdog_ = std::thread(&AuthService::RunWatchdog, this);
+}
+
+AuthService::~AuthService()
+{
+    // Logins that are not done yet fail, queued work is dropped
+    {
+        std::lock_guard<std::mutex> lock(taskMutex_);
+        stopping_ = true;
+        tasks_.clear();
+    }
+
+    taskCondition_.notify_all();
+    watchdogCondition_.notify_all();
+
+    for (std::thread& worker : workers_)
+        worker.join();
+
+    watchdog_.join();
+
+    // Only the resolver and the I/O threads use the connections now, aborting detaches them from those too
+    std::lock_guard<std::mutex> lock(connectionMutex_);
+
+    for (std::shared_ptr<Connection> const& connection : connections_)
+        connection->Abort();
+
+    connections_.clear();
+}
+
+std::future<bool> AuthService::Authenticate(std::shared_ptr<Session> session)
+{
+    ReleaseFinished();
+
+    std::shared_ptr<Connection> connection = std::make_shared<Connection>(this, session);
+    std::future<bool> result = connection->GetFuture();
+
+    {
+        std::lock_guard<std::mutex> lock(connectionMutex_);
+        connections_.push_back(connection);
+    }
+
+    connection->Start();
+    return result;
+}
+
+void AuthService::ReleaseFinished()
+{
+    std::lock_guard<std::mutex> lock(connectionMutex_);
+
+    connections_.erase(std::remove_if(connections_.begin(), connections_.end(), [](std::shared_ptr<Connection> const& connection) {
+        return connection->IsFinished();
+    }), connections_.end());
+}
+
+void AuthService::Post(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(taskMutex_);
+
+        if (stopping_)
+            return;
+
+        tasks_.push_back(std::move(task));
+    }
+
+    taskCondition_.notify_one();
+}
+
+void AuthService::RunWorker()
+{
+    while (true)
+    {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(taskMutex_);
+            taskCondition_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+
+            if (stopping_)
+                return;
+
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+
+        task();
+    }
+}
+
+void AuthService::RunWatchdog()
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(taskMutex_);
+            watchdogCondition_.wait_for(lock, milliseconds(WatchdogInterval), [this]() { return stopping_; });
+
+            if (stopping_)
+                return;
+        }
+
+        steady_clock::time_point now = steady_clock::now();
+        std::vector<std::shared_ptr<Connection>> expired;
+
+        {
+            std::lock_guard<std::mutex> lock(connectionMutex_);
+
+            for (std::shared_ptr<Connection> const& connection : connections_)
+            {
+                if (!connection->IsFinished() && connection->IsConnectExpired(now))
+                    expired.push_back(connection);
+            }
+        }
+
+        // Aborting waits for a running callback of the connection, never with a lock held
+        for (std::shared_ptr<Connection> const& connection : expired)
+        {
+            print("%s", "Connecting to authserver timed out.");
+            connection->Abort();
+        }
+    }
+}
\ No newline at end of file
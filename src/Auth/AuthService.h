@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Define.h"
+#include "Session.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Authenticates many sessions at once. Resolving, connecting and the logon exchanges run
+// on the Resolver and the SocketReactor, so the round trips of every account overlap,
+// while the SRP6 math runs on a bounded pool of worker threads instead of the caller's.
+class AuthService
+{
+    public:
+        const static uint32 MAX_WORKERS = 8;
+
+        // Zero picks one worker per hardware thread, up to MAX_WORKERS
+        explicit AuthService(uint32 workerCount = 0);
+        ~AuthService();
+
+        // The future turns true once the session has its key and realm, or false if
+        // the login failed. The session must not be touched until then.
+        std::future<bool> Authenticate(std::shared_ptr<Session> session);
+
+    private:
+        class Connection;
+
+        void Post(std::function<void()> task);
+        void RunWorker();
+
+        // Fails the logins that are still resolving or connecting past their deadline
+        void RunWatchdog();
+
+        // Drops the connections that are done, the last worker task using one may still hold it
+        void ReleaseFinished();
+
+        std::vector<std::thread> workers_;
+        std::mutex taskMutex_;
+        std::condition_variable taskCondition_;
+        std::deque<std::function<void()>> tasks_;
+        bool stopping_;
+
+        std::thread watchdog_;
+        std::condition_variable watchdogCondition_;  // Shares taskMutex_, wakes the watchdog on shutdown
+
+        std::mutex connectionMutex_;
+        std::vector<std::shared_ptr<Connection>> connections_;
+};
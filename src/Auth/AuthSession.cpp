@@ -18,6 +18,7 @@
 
 #include "AuthSession.h"
 #include "Config.h"
+#include "AuthPackets.h"
 #include "RealmList.h"
 #include <algorithm>
 
@@ -52,12 +53,13 @@ void AuthSession::SendPacket(ByteBuffer& buffer)
     socket_.Send(buffer.contents(), buffer.size());
 }
 
-bool AuthSession::SendLogonChallenge()
+void AuthSession::BuildLogonChallenge(ByteBuffer& packet, Session& session)
 {
-    ByteBuffer packet;
+    std::string accountName = session.GetAccountName();
+
     packet << uint8(AUTH_LOGON_CHALLENGE);
     packet << uint8(8);
-    packet << uint16(session_->GetAccountName().length() + 30);
+    packet << uint16(accountName.length() + 30);
     packet << GameName;
     packet << uint8(GameVersion[0]);
     packet << uint8(GameVersion[1]);
@@ -71,36 +73,19 @@ bool AuthSession::SendLogonChallenge()
     packet << uint8(Locale[0]);
     packet << uint32(TimeZone);
     packet << uint32(IP);
-    packet << uint8(session_->GetAccountName().length());
-    packet.append(session_->GetAccountName().c_str(), session_->GetAccountName().length());
+    packet << uint8(accountName.length());
+    packet.append(accountName.c_str(), accountName.length());
+}
+
+bool AuthSession::SendLogonChallenge()
+{
+    ByteBuffer packet;
+    BuildLogonChallenge(packet, *session_);
 
     SendPacket(packet);
     return HandleLogonChallengeResponse();
 }
 
-#pragma pack(push, 1)
-
-struct LogonChallengeResponse_Header
-{
-    AuthCmd Opcode;
-    uint8 Unk;
-    AuthResult Result;
-};
- 
-struct LogonChallengeResponse_Body
-{
-    uint8 B[32];
-    uint8 g_length;
-    uint8 g[1];
-    uint8 N_length;
-    uint8 N[32];
-    uint8 Salt[32];
-    uint8 CRCSalt[16];
-    uint8 SecurityFlags;
-};
-
-#pragma pack(pop)
-
 bool AuthSession::HandleLogonChallengeResponse()
 {
     LogonChallengeResponse_Header header;
@@ -116,58 +101,50 @@ bool AuthSession::HandleLogonChallengeResponse()
     LogonChallengeResponse_Body body;
     socket_.Read((char*)&body, sizeof(LogonChallengeResponse_Body));
 
-    // TODO: Implement
+    // TODO: Implement the PIN (0x01), matrix card (0x02) and authenticator token (0x04) security flags
     assert(body.SecurityFlags == 0);
 
-    srp6_.Reset();
-    srp6_.SetCredentials(session_->GetAccountName(), session_->GetAccountPassword());
-    srp6_.SetServerModulus(body.N, body.N_length);
-    srp6_.SetServerGenerator(body.g, body.g_length);
-    srp6_.SetServerEphemeralB(body.B, 32);
-    srp6_.SetServerSalt(body.Salt, 32);
-    srp6_.Calculate();
-
-    session_->SetKey(*srp6_.GetClientK());
-
+    CalculateProof(srp6_, *session_, body);
     return SendLogonProof();
 }
 
-bool AuthSession::SendLogonProof()
+void AuthSession::CalculateProof(SRP6& srp6, Session& session, LogonChallengeResponse_Body const& body)
+{
+    srp6.Reset();
+    srp6.SetCredentials(session.GetAccountName(), session.GetAccountPassword());
+    srp6.SetServerModulus(body.N, body.N_length);
+    srp6.SetServerGenerator(body.g, body.g_length);
+    srp6.SetServerEphemeralB(body.B, 32);
+    srp6.SetServerSalt(body.Salt, 32);
+    srp6.Calculate();
+
+    session.SetKey(*srp6.GetClientK());
+}
+
+void AuthSession::BuildLogonProof(ByteBuffer& packet, SRP6& srp6)
 {
     // TODO: Implement CRC calculation
     BigNumber crc;
     crc.SetRandom(20 * 8);
 
-    ByteBuffer packet;
+    // Fixed sizes, a value with leading zero bytes still takes up its whole field
     packet << uint8(AUTH_LOGON_PROOF);
-    packet.append(srp6_.GetClientEphemeralA()->AsByteArray(32).get(), srp6_.GetClientEphemeralA()->GetNumBytes());
-    packet.append(srp6_.GetClientM1()->AsByteArray(20).get(), srp6_.GetClientM1()->GetNumBytes());
-    packet.append(crc.AsByteArray(20).get(), crc.GetNumBytes());
+    packet.append(srp6.GetClientEphemeralA()->AsByteArray(32).get(), 32);
+    packet.append(srp6.GetClientM1()->AsByteArray(20).get(), 20);
+    packet.append(crc.AsByteArray(20).get(), 20);
     packet << uint8(0);
     packet << uint8(0);
+}
+
+bool AuthSession::SendLogonProof()
+{
+    ByteBuffer packet;
+    BuildLogonProof(packet, srp6_);
 
     SendPacket(packet);
     return HandleLogonProofResponse();
 }
 
-#pragma pack(push, 1)
-
-struct LogonProofResponse_Header
-{
-    AuthCmd Opcode;
-    AuthResult Result;
-};
- 
-struct LogonProofResponse_Body
-{
-    uint8   M2[20];
-    uint32  Unk1;
-    uint32  Unk2;
-    uint16  Unk3;
-};
- 
-#pragma pack(pop)
-
 bool AuthSession::HandleLogonProofResponse()
 {
     LogonProofResponse_Header header;
@@ -189,26 +166,19 @@ bool AuthSession::HandleLogonProofResponse()
     return SendRealmlistRequest();
 }
 
-bool AuthSession::SendRealmlistRequest()
+void AuthSession::BuildRealmlistRequest(ByteBuffer& packet)
 {
-    ByteBuffer packet;
     packet << uint8(REALM_LIST);
     packet << uint32(0x1000);
-    SendPacket(packet);
-    return HandleRealmlistResponse();
 }
 
-#pragma pack(push, 1)
-
-struct RealmlistResponse_Header
+bool AuthSession::SendRealmlistRequest()
 {
-    AuthCmd Opcode;
-    uint16 Length;
-    uint32 Unk;
-    uint16 Count;
-};
-
-#pragma pack(pop)
+    ByteBuffer packet;
+    BuildRealmlistRequest(packet);
+    SendPacket(packet);
+    return HandleRealmlistResponse();
+}
 
 bool AuthSession::HandleRealmlistResponse()
 {
@@ -224,11 +194,23 @@ bool AuthSession::HandleRealmlistResponse()
     ByteBuffer buffer;
     socket_.Read(&buffer, header.Length - sizeof(header.Unk) - sizeof(header.Count));
     
+    ByteReader reader(buffer);
+    return SelectRealm(*session_, header.Count, reader);
+}
+
+bool AuthSession::SelectRealm(Session& session, uint32 count, ByteReader& reader)
+{
     RealmList realmlist;
-    realmlist.Populate(header.Count, buffer);
+
+    if (!realmlist.Populate(count, reader))
+    {
+        error("%s", "The authserver sent a malformed realm list!");
+        return false;
+    }
+
     realmlist.Print();
 
-    if (Realm const* realm = realmlist.GetRealmByName(session_->GetRealmName()))
+    if (Realm const* realm = realmlist.GetRealmByName(session.GetRealmName()))
     {
         if (realm->Flags & REALM_FLAG_OFFLINE)
         {
@@ -236,11 +218,11 @@ bool AuthSession::HandleRealmlistResponse()
             return false;
         }
 
-        session_->SetRealm(*realm);
+        session.SetRealm(*realm);
     }
     else
     {
-        error("There is no realm named '%s'! Please choose another one!", session_->GetRealmName().c_str());
+        error("There is no realm named '%s'! Please choose another one!", session.GetRealmName().c_str());
         return false;
     }
 
@@ -24,6 +24,8 @@
 #include "Network/TCPSocket.h"
 #include "Cryptography/SRP6.h"
 
+struct LogonChallengeResponse_Body;
+
 class AuthSession
 {
     public:
@@ -31,6 +33,15 @@ class AuthSession
         ~AuthSession();
 
         bool Authenticate();
+
+        // Steps of the logon exchange, shared with AuthService
+        static void BuildLogonChallenge(ByteBuffer& packet, Session& session);
+        static void CalculateProof(SRP6& srp6, Session& session, LogonChallengeResponse_Body const& body);
+        static void BuildLogonProof(ByteBuffer& packet, SRP6& srp6);
+        static void BuildRealmlistRequest(ByteBuffer& packet);
+        static bool SelectRealm(Session& session, uint32 count, ByteReader& reader);
+
+        static std::string AuthResultToStr(AuthResult result);
     private:
         bool SendLogonChallenge();
         bool SendLogonProof();
@@ -46,6 +57,4 @@ class AuthSession
         SRP6 srp6_;
 
         void SendPacket(ByteBuffer& buffer);
-
-        std::string AuthResultToStr(AuthResult result);
 };
\ No newline at end of file
@@ -18,35 +18,44 @@
 #include "RealmList.h"
 #include "Config.h"
 
-void RealmList::Populate(uint32 count, ByteBuffer &buffer)
+bool RealmList::Populate(uint32 count, ByteReader &buffer)
 {
     list_.clear();
-    list_.resize(count);
+    list_.reserve(count);
 
     for (uint32 i = 0; i < count; i++)
     {
         Realm realm;
 
-        buffer >> realm.Icon;
-        buffer >> realm.Lock;
-        realm.Flags = buffer.read<RealmFlags>();
-        buffer >> realm.Name;
-        buffer >> realm.Address;
-        buffer >> realm.Population;
-        buffer >> realm.Characters;
-        buffer >> realm.Timezone;
-        buffer >> realm.ID;
+        buffer.TryRead(realm.Icon);
+        buffer.TryRead(realm.Lock);
+        buffer.TryRead(realm.Flags);
+        buffer.TryRead(realm.Name);
+        buffer.TryRead(realm.Address);
+        buffer.TryRead(realm.Population);
+        buffer.TryRead(realm.Characters);
+        buffer.TryRead(realm.Timezone);
+        buffer.TryRead(realm.ID);
 
         if (realm.Flags & REALM_FLAG_SPECIFYBUILD)
         {
-            buffer >> realm.MajorVersion;
-            buffer >> realm.MinorVersion;
-            buffer >> realm.BugfixVersion;
-            buffer >> realm.Build;
+            buffer.TryRead(realm.MajorVersion);
+            buffer.TryRead(realm.MinorVersion);
+            buffer.TryRead(realm.BugfixVersion);
+            buffer.TryRead(realm.Build);
         }
 
-        list_[i] = realm;
+        // The error is sticky, checking once per realm is enough
+        if (buffer.HasReadError())
+        {
+            list_.clear();
+            return false;
+        }
+
+        list_.push_back(realm);
     }
+
+    return true;
 }
 
 void RealmList::Print()
@@ -18,7 +18,7 @@
 #pragma once
 
 #include "Define.h"
-#include "Network/ByteBuffer.h"
+#include "Network/ByteReader.h"
 #include <vector>
  
 enum RealmFlags : uint8
@@ -54,7 +54,8 @@ struct Realm
 class RealmList
 {
     public:
-        void Populate(uint32 count, ByteBuffer &buffer);
+        // Never throws, false and an empty list if the data is truncated
+        bool Populate(uint32 count, ByteReader &buffer);
         void Print();
 
         Realm const* GetRealmByName(std::string name);
@@ -27,4 +27,8 @@ static const std::string Platform = "x86";              // x86 | x64 | PPC
 static const std::string OS = "OSX";                    // Win | OSX
 static const uint8 Locale[4] = { 'e', 'n', 'U', 'S' };  // enUS | enGB | frFR | deDE | koKR | zhCN | zhTW | ruRU | esES | esMX | ptBR
 static const uint32 TimeZone = 0x3C;
-static const uint32 IP = 0x0100007F;
\ No newline at end of file
+static const uint32 IP = 0x0100007F;
+
+// Runs world packet handlers directly on the I/O thread instead of the session's
+// event thread. Lowers latency, see WorldSession for the threading rules.
+static const bool InlineDispatch = false;
@@ -231,15 +231,17 @@ bool BigNumber::isZero() const
 
 std::unique_ptr<uint8[]> BigNumber::AsByteArray(int32 minSize, bool littleEndian) const
 {
-    int length = (minSize >= GetNumBytes()) ? minSize : GetNumBytes();
+    int32 numBytes = GetNumBytes();
+    int length = (minSize >= numBytes) ? minSize : numBytes;
 
     uint8* array = new uint8[length];
 
     // If we need more bytes than length of BigNumber set the rest to 0
-    if (length > GetNumBytes())
+    if (length > numBytes)
         memset((void*)array, 0, length);
 
-    BN_bn2bin(bn_, (unsigned char *)array);
+    // Right aligned, so the padding ends up in the most significant bytes
+    BN_bn2bin(bn_, (unsigned char *)array + (length - numBytes));
 
     // openssl's BN stores data internally in big endian format, reverse if little endian desired
     if (littleEndian)
@@ -259,3 +261,155 @@ char* BigNumber::AsDecStr() const
     return BN_bn2dec(bn_);
 }
 
+BigNumberContext::BigNumberContext() : ctx_(BN_CTX_new()), mont_(nullptr)
+{
+}
+
+BigNumberContext::~BigNumberContext()
+{
+    if (mont_)
+        BN_MONT_CTX_free(mont_);
+
+    BN_CTX_free(ctx_);
+}
+
+void BigNumberContext::SetModulus(BigNumber const& modulus)
+{
+    if (mont_ && BN_cmp(modulus_.bn_, modulus.bn_) == 0)
+        return;
+
+    modulus_ = modulus;
+
+    if (mont_)
+    {
+        BN_MONT_CTX_free(mont_);
+        mont_ = nullptr;
+    }
+
+    // Montgomery multiplication needs an odd modulus, BN_mod_exp falls back the same way
+    if (!BN_is_odd(modulus_.bn_))
+        return;
+
+    mont_ = BN_MONT_CTX_new();
+
+    if (!BN_MONT_CTX_set(mont_, modulus_.bn_, ctx_))
+    {
+        BN_MONT_CTX_free(mont_);
+        mont_ = nullptr;
+    }
+}
+
+void BigNumberContext::Mod(BigNumber& result, BigNumber const& value)
+{
+    BN_mod(result.bn_, value.bn_, modulus_.bn_, ctx_);
+}
+
+void BigNumberContext::ModExp(BigNumber& result, BigNumber const& base, BigNumber const& exponent)
+{
+    if (!mont_)
+    {
+        BN_mod_exp(result.bn_, base.bn_, exponent.bn_, modulus_.bn_, ctx_);
+        return;
+    }
+
+    // Same dispatch as BN_mod_exp, with the Montgomery form reused
+    bool constTime = BN_get_flags(base.bn_, BN_FLG_CONSTTIME) || BN_get_flags(exponent.bn_, BN_FLG_CONSTTIME);
+
+    if (constTime)
+        BN_mod_exp_mont_consttime(result.bn_, base.bn_, exponent.bn_, modulus_.bn_, ctx_, mont_);
+    else if (BN_num_bytes(base.bn_) <= int32(sizeof(BN_ULONG)) && !BN_is_negative(base.bn_))
+        BN_mod_exp_mont_word(result.bn_, BN_get_word(base.bn_), exponent.bn_, modulus_.bn_, ctx_, mont_);
+    else
+        BN_mod_exp_mont(result.bn_, base.bn_, exponent.bn_, modulus_.bn_, ctx_, mont_);
+}
+
+void BigNumberContext::Mul(BigNumber& result, BigNumber const& left, BigNumber const& right)
+{
+    BN_mul(result.bn_, left.bn_, right.bn_, ctx_);
+}
+
+FixedBaseTable::FixedBaseTable(BigNumber const& base, BigNumber const& modulus, int32 maxBytes)
+    : base_(base), modulus_(modulus), maxBytes_(maxBytes < MAX_BYTES ? maxBytes : MAX_BYTES), mont_(nullptr)
+{
+    if (!BN_is_odd(modulus_.bn_) || BN_is_negative(base_.bn_))
+        return;
+
+    BigNumberContext context;
+    mont_ = BN_MONT_CTX_new();
+
+    if (!BN_MONT_CTX_set(mont_, modulus_.bn_, context.ctx_))
+    {
+        BN_MONT_CTX_free(mont_);
+        mont_ = nullptr;
+        return;
+    }
+
+    powers_.resize(size_t(maxBytes_) * 255);
+
+    // First entry of a row: base^(256^row), the previous row's last entry times its first
+    BN_nnmod(powers_[0].bn_, base_.bn_, modulus_.bn_, context.ctx_);
+    BN_to_montgomery(powers_[0].bn_, powers_[0].bn_, mont_, context.ctx_);
+
+    for (int32 row = 0; row < maxBytes_; ++row)
+    {
+        BigNumber* powers = &powers_[size_t(row) * 255];
+
+        if (row)
+            BN_mod_mul_montgomery(powers[0].bn_, powers[-1].bn_, powers[-255].bn_, mont_, context.ctx_);
+
+        for (uint32 digit = 1; digit < 255; ++digit)
+            BN_mod_mul_montgomery(powers[digit].bn_, powers[digit - 1].bn_, powers[0].bn_, mont_, context.ctx_);
+    }
+}
+
+FixedBaseTable::~FixedBaseTable()
+{
+    if (mont_)
+        BN_MONT_CTX_free(mont_);
+}
+
+bool FixedBaseTable::Matches(BigNumber const& base, BigNumber const& modulus) const
+{
+    return BN_cmp(base_.bn_, base.bn_) == 0 && BN_cmp(modulus_.bn_, modulus.bn_) == 0;
+}
+
+bool FixedBaseTable::ModExp(BigNumber& result, BigNumber const& exponent, BigNumberContext& context) const
+{
+    int32 length = BN_num_bytes(exponent.bn_);
+
+    if (!mont_ || length > maxBytes_ || BN_is_negative(exponent.bn_))
+        return false;
+
+    uint8 digits[MAX_BYTES];
+    BN_bn2bin(exponent.bn_, digits);
+
+    bool empty = true;
+
+    for (int32 i = 0; i < length; ++i)
+    {
+        uint8 digit = digits[length - 1 - i];
+
+        if (!digit)
+            continue;
+
+        BIGNUM const* power = powers_[size_t(i) * 255 + digit - 1].bn_;
+
+        if (empty)
+            BN_copy(result.bn_, power);
+        else
+            BN_mod_mul_montgomery(result.bn_, result.bn_, power, mont_, context.ctx_);
+
+        empty = false;
+    }
+
+    if (empty)
+        BN_one(result.bn_);
+    else
+        BN_from_montgomery(result.bn_, result.bn_, mont_, context.ctx_);
+
+    // Matches BN_mod_exp for a modulus of one
+    if (BN_is_one(modulus_.bn_))
+        BN_zero(result.bn_);
+
+    return true;
+}
@@ -21,11 +21,17 @@
 
 #include "Define.h"
 #include <memory>
+#include <vector>
 
 struct bignum_st;
+struct bignum_ctx;
+struct bn_mont_ctx_st;
 
 class BigNumber
 {
+    friend class BigNumberContext;
+    friend class FixedBaseTable;
+
     public:
         BigNumber();
         BigNumber(BigNumber const& bn);
@@ -109,3 +115,60 @@ class BigNumber
         struct bignum_st *bn_;
 };
 
+// Scratch space and the Montgomery form of a modulus, kept alive across the operations
+// of a calculation instead of being set up again by every BigNumber operator
+class BigNumberContext
+{
+    friend class FixedBaseTable;
+
+    public:
+        BigNumberContext();
+        ~BigNumberContext();
+
+        // Precomputes the Montgomery form, unless the modulus is the one set before
+        void SetModulus(BigNumber const& modulus);
+        BigNumber const& GetModulus() const { return modulus_; }
+
+        // Operations modulo the modulus
+        void Mod(BigNumber& result, BigNumber const& value);
+        void ModExp(BigNumber& result, BigNumber const& base, BigNumber const& exponent);
+
+        void Mul(BigNumber& result, BigNumber const& left, BigNumber const& right);
+
+    private:
+        BigNumberContext(BigNumberContext const&);
+        BigNumberContext& operator=(BigNumberContext const&);
+
+        struct bignum_ctx* ctx_;
+        struct bn_mont_ctx_st* mont_;   // Null if the modulus is even
+        BigNumber modulus_;
+};
+
+// Powers of a fixed base modulo a fixed modulus. Every byte of the exponent has its own row
+// of base^(digit * 256^row), so raising the base costs one multiplication per exponent byte
+// instead of a square and multiply chain. Immutable once built, can be shared by threads.
+class FixedBaseTable
+{
+    public:
+        const static int32 MAX_BYTES = 64;
+
+        // maxBytes is capped at MAX_BYTES
+        FixedBaseTable(BigNumber const& base, BigNumber const& modulus, int32 maxBytes);
+        ~FixedBaseTable();
+
+        bool Matches(BigNumber const& base, BigNumber const& modulus) const;
+
+        // Fails without touching the result if the exponent has more than maxBytes bytes,
+        // is negative or the modulus is even
+        bool ModExp(BigNumber& result, BigNumber const& exponent, BigNumberContext& context) const;
+
+    private:
+        FixedBaseTable(FixedBaseTable const&);
+        FixedBaseTable& operator=(FixedBaseTable const&);
+
+        BigNumber base_;
+        BigNumber modulus_;
+        int32 maxBytes_;
+        struct bn_mont_ctx_st* mont_;
+        std::vector<BigNumber> powers_;     // Montgomery form, 255 per row, digit 0 is left out
+};
@@ -20,7 +20,6 @@
 #include "PacketRC4.h"
 #include "BigNumber.h"
 #include "HMACSHA1.h"
-#include <cstring>
 
 PacketRC4::PacketRC4() : ready_(false), decrypt_(20), encrypt_(20)
 {
@@ -51,11 +50,8 @@ void PacketRC4::Initialize(const BigNumber* key)
     encrypt_.Initialize(encryptHMAC.GetDigest());
 
     // Drop-N
-    uint8 drop[1024];
-    memset(drop, 0, 1024);
-
-    encrypt_.Update(drop, 1024);
-    decrypt_.Update(drop, 1024);
+    encrypt_.Skip(1024);
+    decrypt_.Skip(1024);
 
     ready_ = true;
 }
@@ -80,3 +76,12 @@ void PacketRC4::EncryptSend(uint8* data, int32 len)
 
     encrypt_.Update(data, len);
 }
+
+void PacketRC4::CollectCiphers(std::vector<RC4*>& ciphers)
+{
+    if (!ready_)
+        return;
+
+    ciphers.push_back(&decrypt_);
+    ciphers.push_back(&encrypt_);
+}
@@ -20,6 +20,7 @@
 #pragma once
 
 #include "RC4.h"
+#include <vector>
 
 class BigNumber;
 
@@ -35,6 +36,9 @@ class PacketRC4
         void EncryptSend(uint8* data, int32 len);
         bool IsInitialized() { return ready_; }
 
+        // Adds the ciphers in use for a batched RC4::Refill
+        void CollectCiphers(std::vector<RC4*>& ciphers);
+
     private:
         bool ready_;
         RC4 decrypt_;
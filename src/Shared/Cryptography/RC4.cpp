@@ -18,35 +18,177 @@
  */
 
 #include "RC4.h"
+#include <algorithm>
+#include <cstring>
 
-RC4::RC4(int32 len) : ctx_()
+RC4::RC4(int32 len) : x_(0), y_(0), keyLength_(len), position_(0), size_(0)
 {
-    EVP_CIPHER_CTX_init(&ctx_);
-    EVP_EncryptInit_ex(&ctx_, EVP_rc4(), nullptr, nullptr, nullptr);
-    EVP_CIPHER_CTX_set_key_length(&ctx_, len);
+    std::memset(state_, 0, sizeof(state_));
 }
 
-RC4::RC4(uint8* seed, int32 len) : ctx_()
+RC4::RC4(uint8* seed, int32 len) : x_(0), y_(0), keyLength_(len), position_(0), size_(0)
 {
-    EVP_CIPHER_CTX_init(&ctx_);
-    EVP_EncryptInit_ex(&ctx_, EVP_rc4(), nullptr, nullptr, nullptr);
-    EVP_CIPHER_CTX_set_key_length(&ctx_, len);
-    EVP_EncryptInit_ex(&ctx_, nullptr, nullptr, seed, nullptr);
+    Initialize(seed);
 }
 
-RC4::~RC4()
+void RC4::Initialize(uint8* seed)
 {
-    EVP_CIPHER_CTX_cleanup(&ctx_);
+    for (uint32 i = 0; i < 256; ++i)
+        state_[i] = i;
+
+    uint32 j = 0;
+
+    for (uint32 i = 0; i < 256; ++i)
+    {
+        j = (j + state_[i] + seed[i % keyLength_]) & 0xFF;
+        std::swap(state_[i], state_[j]);
+    }
+
+    x_ = 0;
+    y_ = 0;
+
+    // Whatever was buffered belongs to the previous key
+    position_ = 0;
+    size_ = 0;
 }
 
-void RC4::Initialize(uint8* seed)
+void RC4::Compact()
+{
+    uint32 remaining = size_ - position_;
+
+    if (position_ && remaining)
+        std::memmove(keystream_, keystream_ + position_, remaining);
+
+    position_ = 0;
+    size_ = remaining;
+}
+
+#define RC4_STEP(state, x, y, out)          \
+    {                                       \
+        x = (x + 1) & 0xFF;                 \
+        uint32 a = state[x];                \
+        y = (y + a) & 0xFF;                 \
+        uint32 b = state[y];                \
+        state[x] = b;                       \
+        state[y] = a;                       \
+        out = uint8(state[(a + b) & 0xFF]); \
+    }
+
+void RC4::Generate(uint32 len)
+{
+    // Work on locals, the compiler can't prove that the keystream doesn't alias the state
+    uint32* __restrict state = state_;
+    uint8* __restrict keystream = keystream_ + size_;
+    uint32 x = x_;
+    uint32 y = y_;
+
+    for (uint32 i = 0; i < len; ++i)
+        RC4_STEP(state, x, y, keystream[i]);
+
+    x_ = x;
+    y_ = y;
+    size_ += len;
+}
+
+void RC4::Generate(RC4& first, RC4& second, uint32 len)
 {
-    EVP_EncryptInit_ex(&ctx_, nullptr, nullptr, seed, nullptr);
+    // Two lanes fit in registers, with more the locals spill and it gets slower again
+    uint32* __restrict state1 = first.state_;
+    uint32* __restrict state2 = second.state_;
+    uint8* __restrict keystream1 = first.keystream_ + first.size_;
+    uint8* __restrict keystream2 = second.keystream_ + second.size_;
+    uint32 x1 = first.x_, y1 = first.y_;
+    uint32 x2 = second.x_, y2 = second.y_;
+
+    for (uint32 i = 0; i < len; ++i)
+    {
+        RC4_STEP(state1, x1, y1, keystream1[i]);
+        RC4_STEP(state2, x2, y2, keystream2[i]);
+    }
+
+    first.x_ = x1;
+    first.y_ = y1;
+    first.size_ += len;
+
+    second.x_ = x2;
+    second.y_ = y2;
+    second.size_ += len;
+}
+
+#undef RC4_STEP
+
+void RC4::Refill(RC4* const* ciphers, size_t count)
+{
+    RC4* pending = nullptr;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        RC4* cipher = ciphers[i];
+
+        // A repeated entry must not become its own partner, the lanes can't alias
+        if (cipher == pending || cipher->size_ - cipher->position_ >= REFILL_SIZE)
+            continue;
+
+        // Leaves room for at least REFILL_SIZE bytes
+        cipher->Compact();
+
+        if (!pending)
+        {
+            pending = cipher;
+            continue;
+        }
+
+        Generate(*pending, *cipher, REFILL_SIZE);
+        pending = nullptr;
+    }
+
+    // Scalar fallback for the odd one out
+    if (pending)
+        pending->Generate(REFILL_SIZE);
 }
 
 void RC4::Update(uint8* data, int32 len)
 {
-    int32 outlen = 0;
-    EVP_EncryptUpdate(&ctx_, data, &outlen, data, len);
-    EVP_EncryptFinal_ex(&ctx_, data, &outlen);
+    while (len > 0)
+    {
+        if (position_ == size_)
+        {
+            position_ = 0;
+            size_ = 0;
+            Generate(KEYSTREAM_SIZE);
+        }
+
+        uint32 count = size_ - position_;
+        if (count > uint32(len))
+            count = uint32(len);
+
+        uint8 const* keystream = keystream_ + position_;
+
+        for (uint32 i = 0; i < count; ++i)
+            data[i] ^= keystream[i];
+
+        data += count;
+        len -= int32(count);
+        position_ += count;
+    }
+}
+
+void RC4::Skip(int32 len)
+{
+    while (len > 0)
+    {
+        if (position_ == size_)
+        {
+            position_ = 0;
+            size_ = 0;
+            Generate(KEYSTREAM_SIZE);
+        }
+
+        uint32 count = size_ - position_;
+        if (count > uint32(len))
+            count = uint32(len);
+
+        len -= int32(count);
+        position_ += count;
+    }
 }
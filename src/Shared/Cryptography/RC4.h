@@ -20,17 +20,43 @@
 #pragma once
 
 #include "Define.h"
-#include <openssl/evp.h>
+#include <cstddef>
 
+// ARC4 stream cipher. The keystream is generated ahead of use in blocks, so encrypting
+// the few bytes of a packet header is a plain XOR against the buffered keystream.
 class RC4
 {
     public:
+        const static uint32 KEYSTREAM_SIZE = 0x1000;
+        const static uint32 REFILL_SIZE = KEYSTREAM_SIZE / 2;   // Ciphers with less buffered are topped up by Refill
+
         RC4(int32 len);
         RC4(uint8* seed, int32 len);
-        ~RC4();
 
         void Initialize(uint8* seed);
         void Update(uint8* data, int32 len);
+
+        // Advances the keystream without using it (RC4-drop)
+        void Skip(int32 len);
+
+        // Tops up the buffered keystream of the ciphers running low. Independent ciphers are
+        // generated two at a time, interleaving their permutation updates hides the load latency
+        // a single stream is bound by. Update refills a cipher on its own when it runs dry anyway.
+        // A cipher listed more than once is refilled once.
+        static void Refill(RC4* const* ciphers, size_t count);
+
     private:
-        EVP_CIPHER_CTX ctx_;
+        void Compact();
+        void Generate(uint32 len);
+        static void Generate(RC4& first, RC4& second, uint32 len);
+
+        // Kept as words, byte sized entries stall on partial register writes
+        uint32 state_[256];
+        uint32 x_;
+        uint32 y_;
+        int32 keyLength_;
+
+        uint8 keystream_[KEYSTREAM_SIZE];
+        uint32 position_;                       // Next unused keystream byte
+        uint32 size_;                           // End of the generated keystream
 };
@@ -17,6 +17,11 @@
 
 #include "SRP6.h"
 #include <algorithm>
+#include <mutex>
+#include <vector>
+
+const int32 SRP6::GENERATOR_TABLE_BYTES;
+const uint32 SRP6::MAX_GENERATOR_TABLES;
 
 SRP6::SRP6()
 {
@@ -52,31 +57,65 @@ void SRP6::SetCredentials(std::string name, std::string password)
     AccountName = name;
     AccountPassword = password;
 }
-void SRP6::SetServerModulus(uint8* buffer, uint32 length)
+void SRP6::SetServerModulus(uint8 const* buffer, uint32 length)
 {
     N.SetBinary(buffer, length);
 }
 
-void SRP6::SetServerGenerator(uint8* buffer, uint32 length)
+void SRP6::SetServerGenerator(uint8 const* buffer, uint32 length)
 {
     g.SetBinary(buffer, length);
 }
 
-void SRP6::SetServerEphemeralB(uint8* buffer, uint32 length)
+void SRP6::SetServerEphemeralB(uint8 const* buffer, uint32 length)
 {
     B.SetBinary(buffer, length);
 }
 
-void SRP6::SetServerSalt(uint8* buffer, uint32 length)
+void SRP6::SetServerSalt(uint8 const* buffer, uint32 length)
 {
     s.SetBinary(buffer, length);
 }
 
+void SRP6::SetClientSecret(uint8 const* buffer, uint32 length)
+{
+    a.SetBinary(buffer, length);
+}
+
+std::shared_ptr<FixedBaseTable const> SRP6::GetGeneratorTable(BigNumber const& generator, BigNumber const& modulus)
+{
+    static std::mutex mutex;
+    static std::vector<std::shared_ptr<FixedBaseTable const>> tables;
+
+    // Built under the lock, logins racing for a new server would all build the same table
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (std::shared_ptr<FixedBaseTable const> const& table : tables)
+    {
+        if (table->Matches(generator, modulus))
+            return table;
+    }
+
+    if (tables.size() == MAX_GENERATOR_TABLES)
+        tables.erase(tables.begin());
+
+    tables.push_back(std::make_shared<FixedBaseTable>(generator, modulus, GENERATOR_TABLE_BYTES));
+    return tables.back();
+}
+
 void SRP6::Calculate()
 {
+    context_.SetModulus(N);
+
+    if (!generatorTable_ || !generatorTable_->Matches(g, N))
+        generatorTable_ = GetGeneratorTable(g, N);
+
     // Safeguards
 
-    if (B.IsZero() || (B % N).IsZero())
+    BigNumber reduced;
+    context_.Mod(reduced, B);
+
+    if (B.IsZero() || reduced.IsZero())
     {
         print("%s", "SRP safeguard: B (mod N) was zero!");
         return;
@@ -120,7 +159,8 @@ void SRP6::Calculate()
 
     // A
 
-    A = g.ModExp(a, N);
+    if (!generatorTable_->ModExp(A, a, context_))
+        context_.ModExp(A, g, a);
 
     // u = H(A, B)
 
@@ -139,11 +179,21 @@ void SRP6::Calculate()
 
     // v
 
-    v = g.ModExp(x, N);
+    if (!generatorTable_->ModExp(v, x, context_))
+        context_.ModExp(v, g, x);
+
+    // S = (B - k * v) ^ (a + u * x)
+
+    BigNumber base = N - v;
+    context_.Mul(base, k, base);
+    base += B;
+    context_.Mod(base, base);
 
-    // S
+    BigNumber exponent;
+    context_.Mul(exponent, u, x);
+    exponent += a;
 
-    S = ((B + k * (N - g.ModExp(x, N))) % N).ModExp(a + (u * x), N);
+    context_.ModExp(S, base, exponent);
 
     if (S.IsZero() || S.IsNegative())
     {
@@ -153,12 +203,13 @@ void SRP6::Calculate()
 
     // K
 
+    std::unique_ptr<uint8[]> bS = S.AsByteArray(32);
     uint8 SPart[2][16];
 
     for (int i = 0; i < 16; i++)
     {
-        SPart[0][i] = S.AsByteArray()[i * 2];
-        SPart[1][i] = S.AsByteArray()[i * 2 + 1];
+        SPart[0][i] = bS[i * 2];
+        SPart[1][i] = bS[i * 2 + 1];
     }
 
     SHA1 hEven;
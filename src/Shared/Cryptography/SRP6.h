@@ -30,10 +30,11 @@ class SRP6
 
         void Reset();
         void SetCredentials(std::string name, std::string password);
-        void SetServerModulus(uint8* buffer, uint32 length);
-        void SetServerGenerator(uint8* buffer, uint32 length);
-        void SetServerEphemeralB(uint8* buffer, uint32 length);
-        void SetServerSalt(uint8* buffer, uint32 length);
+        void SetServerModulus(uint8 const* buffer, uint32 length);
+        void SetServerGenerator(uint8 const* buffer, uint32 length);
+        void SetServerEphemeralB(uint8 const* buffer, uint32 length);
+        void SetServerSalt(uint8 const* buffer, uint32 length);
+        void SetClientSecret(uint8 const* buffer, uint32 length); // Replaces the random a picked by Reset
         void Calculate();
         bool IsValidM2(uint8* buffer, uint32 length);
 
@@ -42,6 +43,13 @@ class SRP6
         BigNumber* GetClientK() { return &K; }
 
     private:
+        // Powers of g modulo N shared by every login to the same server, sized for
+        // both secret exponents: a and the SHA1 digest x
+        const static int32 GENERATOR_TABLE_BYTES = 20;
+        const static uint32 MAX_GENERATOR_TABLES = 4;
+
+        static std::shared_ptr<FixedBaseTable const> GetGeneratorTable(BigNumber const& generator, BigNumber const& modulus);
+
         std::string AccountName;
         std::string AccountPassword;
 
@@ -60,4 +68,7 @@ class SRP6
         BigNumber K; // Key based on S
         BigNumber M1; // M1
         BigNumber M2; // M2
+
+        BigNumberContext context_; // Modulo N, kept across logins to the same server
+        std::shared_ptr<FixedBaseTable const> generatorTable_;
 };
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AsyncSocket.h"
+#include "SocketReactor.h"
+
+AsyncSocket::AsyncSocket() : lane_(-1), attached_(false), wantWrite_(false)
+{
+}
+
+AsyncSocket::~AsyncSocket()
+{
+    AsyncSocket::Disconnect();
+}
+
+bool AsyncSocket::Attach()
+{
+    assert(!attached_);
+
+    if (!IsConnected() || !SetBlocking(false))
+        return false;
+
+    return SocketReactor::instance()->Add(this);
+}
+
+void AsyncSocket::Disconnect()
+{
+    // Unregistering and closing happen under the lane lock, so the I/O thread
+    // never touches a descriptor that has already been closed (or reused).
+    // Taking the lock also waits for a callback of this socket that is still running.
+    SocketReactor::instance()->Remove(this);
+}
+
+void AsyncSocket::RequestWrite()
+{
+    SocketReactor::instance()->RequestWrite(this);
+}
+
+void AsyncSocket::RequestRead()
+{
+    SocketReactor::instance()->RequestRead(this);
+}
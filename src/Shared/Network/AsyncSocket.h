@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Define.h"
+#include "TCPSocket.h"
+#include <atomic>
+#include <vector>
+
+class SocketReactor;
+class RC4;
+
+// A non-blocking TCP socket driven by the SocketReactor. Readiness callbacks of
+// one socket are always invoked from the same I/O thread, one at a time.
+class AsyncSocket : public TCPSocket
+{
+    friend class SocketReactor;
+
+    public:
+        AsyncSocket();
+        virtual ~AsyncSocket();
+
+        void Disconnect() override;
+
+    protected:
+        // Switches the connected socket to non-blocking mode and hands it to the reactor
+        bool Attach();
+
+        // Asks the I/O thread to call OnWritable as soon as the socket accepts data
+        void RequestWrite();
+
+        // Asks the I/O thread to call OnReadable even if no new data arrives,
+        // used to resume reading after the socket stopped consuming its input
+        void RequestRead();
+
+        virtual void OnReadable() = 0;
+        virtual void OnWritable() = 0;
+
+        // Called by the I/O thread after a batch of callbacks, the ciphers of every socket
+        // in the batch get their keystreams refilled together
+        virtual void CollectCiphers(std::vector<RC4*>& /*ciphers*/) { }
+
+    private:
+        std::atomic<int32> lane_;           // Lane of the last Attach, kept to synchronize teardown
+        std::atomic<bool> attached_;
+        std::atomic<bool> wantWrite_;
+};
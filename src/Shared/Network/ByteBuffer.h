@@ -22,6 +22,8 @@
 #include "Define.h"
 #include "Common.h"
 #include "ByteConverter.h"
+#include "ByteStorage.h"
+#include "StringView.h"
 #include "World/ObjectGuid.h"
 
 #include <iostream>
@@ -74,26 +76,55 @@ class ByteBuffer
         const static size_t DEFAULT_SIZE = 0x1000;
 
         // constructor
-        ByteBuffer() : rpos_(0), wpos_(0), bitpos_(8), curbitval_(0)
+        ByteBuffer() : rpos_(0), wpos_(0), bitpos_(8), curbitval_(0), readError_(false)
         {
             storage_.reserve(DEFAULT_SIZE);
         }
 
-        ByteBuffer(size_t reserve) : rpos_(0), wpos_(0), bitpos_(8), curbitval_(0)
+        ByteBuffer(size_t reserve) : rpos_(0), wpos_(0), bitpos_(8), curbitval_(0), readError_(false)
         {
             storage_.reserve(reserve);
         }
 
         // copy constructor
         ByteBuffer(const ByteBuffer &buf) : rpos_(buf.rpos_), wpos_(buf.wpos_),
-            storage_(buf.storage_), bitpos_(buf.bitpos_), curbitval_(buf.curbitval_)
+            storage_(buf.storage_), bitpos_(buf.bitpos_), curbitval_(buf.curbitval_), readError_(buf.readError_)
         {
         }
 
+        // move constructor, the source is left empty
+        ByteBuffer(ByteBuffer &&buf) : rpos_(buf.rpos_), wpos_(buf.wpos_),
+            storage_(std::move(buf.storage_)), bitpos_(buf.bitpos_), curbitval_(buf.curbitval_), readError_(buf.readError_)
+        {
+            buf.clear();
+            buf.ResetBitPos();
+        }
+
+        ByteBuffer &operator=(const ByteBuffer &buf) = default;
+
+        ByteBuffer &operator=(ByteBuffer &&buf)
+        {
+            if (this != &buf)
+            {
+                rpos_ = buf.rpos_;
+                wpos_ = buf.wpos_;
+                storage_ = std::move(buf.storage_);
+                bitpos_ = buf.bitpos_;
+                curbitval_ = buf.curbitval_;
+                readError_ = buf.readError_;
+
+                buf.clear();
+                buf.ResetBitPos();
+            }
+
+            return *this;
+        }
+
         void clear()
         {
             storage_.clear();
             rpos_ = wpos_ = 0;
+            readError_ = false;
         }
 
         template <typename T> void append(T value)
@@ -102,6 +133,15 @@ class ByteBuffer
             append((uint8 *)&value, sizeof(value));
         }
 
+        void ResetBitPos()
+        {
+            if (bitpos_ > 7)
+                return;
+
+            bitpos_ = 8;
+            curbitval_ = 0;
+        }
+
         void FlushBits()
         {
             if (bitpos_ == 8)
@@ -140,20 +180,53 @@ class ByteBuffer
             return ((curbitval_ >> (7 - bitpos_)) & 1) != 0;
         }
 
+        // Writes the low bits of value, most significant first. Same output as calling
+        // WriteBit for every bit: completed bytes are appended right away and fewer than
+        // 8 bits stay pending in curbitval_ between calls.
         template <typename T> void WriteBits(T value, size_t bits)
         {
-            for (int32 i = bits - 1; i >= 0; --i)
-                WriteBit((value >> i) & 1);
+            uint64 raw = uint64(value);
+
+            // Keep every chunk at 56 bits or less, so it fits the accumulator next to the pending bits
+            if (bits > 56)
+            {
+                WriteBitChunk(raw >> 32, bits - 32);
+                bits = 32;
+            }
+
+            WriteBitChunk(raw, bits);
         }
 
         uint32 ReadBits(size_t bits)
         {
-            uint32 value = 0;
-            for (int32 i = bits - 1; i >= 0; --i)
-            if (ReadBit())
-                value |= (1 << (i));
+            assert(bits <= 32);
+
+            if (!bits)
+                return 0;
+
+            // Bits of curbitval_ that ReadBit has not consumed yet
+            uint32 available = bitpos_ > 7 ? 0 : 7 - bitpos_;
+            uint64 accumulator = curbitval_ & ((1 << available) - 1);
+            uint64 mask = (uint64(1) << bits) - 1;
+
+            if (bits <= available)
+            {
+                bitpos_ += bits;
+                return uint32((accumulator >> (available - bits)) & mask);
+            }
 
-            return value;
+            size_t count = (bits - available + 7) / 8;
+            if (rpos_ + count > size())
+                throw ByteBufferPositionException(false, rpos_, count, size());
+
+            for (size_t i = 0; i < count; ++i)
+                accumulator = (accumulator << 8) | storage_[rpos_++];
+
+            uint32 remaining = uint32(available + count * 8 - bits);
+            curbitval_ = storage_[rpos_ - 1];
+            bitpos_ = 7 - remaining;
+
+            return uint32((accumulator >> remaining) & mask);
         }
 
         void ReadByteSeq(uint8& b)
@@ -193,15 +266,41 @@ class ByteBuffer
             }
         }
 
+        // Reads a fixed length field, the result stops at the first NUL inside it
         std::string ReadString(uint32 length)
         {
             if (!length)
                 return std::string();
-            char* buffer = new char[length + 1]();
-            read((uint8*)buffer, length);
-            std::string retval = buffer;
-            delete[] buffer;
-            return retval;
+
+            if (rpos_ + length > size())
+                throw ByteBufferPositionException(false, rpos_, length, size());
+
+            char const* begin = (char const*)&storage_[rpos_];
+            char const* end = (char const*)std::memchr(begin, 0, length);
+            rpos_ += length;
+
+            return std::string(begin, end ? end : begin + length);
+        }
+
+        // Reads a NUL terminated string without copying it. A missing terminator is
+        // tolerated the same way operator>> always did, the view then runs to the end.
+        StringView ReadCString()
+        {
+            if (rpos_ >= size())
+                return StringView();
+
+            char const* begin = (char const*)&storage_[rpos_];
+            size_t remaining = size() - rpos_;
+            char const* end = (char const*)std::memchr(begin, 0, remaining);
+
+            if (!end)
+            {
+                rpos_ = size();
+                return StringView(begin, remaining);
+            }
+
+            rpos_ += (end - begin) + 1;
+            return StringView(begin, end - begin);
         }
 
         void WriteString(std::string const& str)
@@ -357,14 +456,8 @@ class ByteBuffer
 
         ByteBuffer &operator>>(std::string& value)
         {
-            value.clear();
-            while (rpos() < size())                         // prevent crash at wrong string format in packet
-            {
-                char c = read<char>();
-                if (c == 0)
-                    break;
-                value += c;
-            }
+            StringView view = ReadCString();
+            value.assign(view.data(), view.size());
             return *this;
         }
 
@@ -390,9 +483,9 @@ class ByteBuffer
 
         size_t rpos() const { return rpos_; }
 
-        size_t rpos(size_t rpos_)
+        size_t rpos(size_t pos)
         {
-            rpos_ = rpos_;
+            rpos_ = pos;
             return rpos_;
         }
 
@@ -403,9 +496,9 @@ class ByteBuffer
 
         size_t wpos() const { return wpos_; }
 
-        size_t wpos(size_t wpos_)
+        size_t wpos(size_t pos)
         {
-            wpos_ = wpos_;
+            wpos_ = pos;
             return wpos_;
         }
 
@@ -445,26 +538,98 @@ class ByteBuffer
 
         void readPackGUID(uint64_t& guid)
         {
-            if (rpos() + 1 > size())
+            size_t length = PackedGuid::Decode(contents() + rpos_, size() - std::min(rpos_, size()), guid);
+            if (!length)
                 throw ByteBufferPositionException(false, rpos_, 1, size());
 
-            guid = 0;
+            rpos_ += length;
+        }
+
+        // Checked reads, they never throw. A failed read leaves the read position untouched,
+        // zeroes the output and sets a sticky error flag, every following checked read fails
+        // too, so a handler can parse the whole packet and test HasReadError() once at the end.
+        bool HasReadError() const { return readError_; }
+        void ClearReadError() { readError_ = false; }
+
+        template <typename T> bool TryRead(T& value)
+        {
+            if (readError_ || rpos_ + sizeof(T) > size())
+                return SetReadError(value);
+
+            value = *((T const*)&storage_[rpos_]);
+            EndianConvert(value);
+            rpos_ += sizeof(T);
+            return true;
+        }
 
-            uint8_t guidmark = 0;
-            (*this) >> guidmark;
+        bool TryRead(bool& value)
+        {
+            uint8 raw;
+            if (!TryRead(raw))
+                return SetReadError(value);
+
+            value = raw > 0;
+            return true;
+        }
 
-            for (int i = 0; i < 8; ++i)
+        bool TryRead(ObjectGuid& guid)
+        {
+            uint64 raw;
+            if (!TryRead(raw))
             {
-                if (guidmark & (uint8_t(1) << i))
-                {
-                    if (rpos() + 1 > size())
-                        throw ByteBufferPositionException(false, rpos_, 1, size());
-
-                    uint8_t bit;
-                    (*this) >> bit;
-                    guid |= (uint64_t(bit) << (i * 8));
-                }
+                guid.Clear();
+                return false;
             }
+
+            guid.Set(raw);
+            return true;
+        }
+
+        // Unlike operator>>, a string that runs to the end of the buffer without its
+        // terminator counts as a failed read
+        bool TryRead(StringView& value)
+        {
+            if (readError_ || rpos_ >= size())
+                return SetReadError(value);
+
+            char const* begin = (char const*)&storage_[rpos_];
+            char const* end = (char const*)std::memchr(begin, 0, size() - rpos_);
+
+            if (!end)
+                return SetReadError(value);
+
+            value = StringView(begin, end - begin);
+            rpos_ += (end - begin) + 1;
+            return true;
+        }
+
+        bool TryRead(std::string& value)
+        {
+            StringView view;
+            bool result = TryRead(view);
+            value.assign(view.data(), view.size());
+            return result;
+        }
+
+        bool TryReadSkip(size_t skip)
+        {
+            if (readError_ || rpos_ + skip > size())
+                return SetReadError();
+
+            rpos_ += skip;
+            return true;
+        }
+
+        template <typename T> bool TryReadSkip() { return TryReadSkip(sizeof(T)); }
+
+        bool TryReadPackGUID(uint64& guid)
+        {
+            size_t length = readError_ ? 0 : PackedGuid::Decode(contents() + rpos_, size() - std::min(rpos_, size()), guid);
+            if (!length)
+                return SetReadError(guid);
+
+            rpos_ += length;
+            return true;
         }
 
         uint32 ReadPackedTime()
@@ -493,16 +658,18 @@ class ByteBuffer
             return read<uint64>();
         }
 
-        uint8 * contents() { return &storage_[0]; }
+        uint8 * contents() { return storage_.data(); }
 
-        const uint8 *contents() const { return &storage_[0]; }
+        const uint8 *contents() const { return storage_.data(); }
 
         size_t size() const { return storage_.size(); }
         bool empty() const { return storage_.empty(); }
+        size_t capacity() const { return storage_.capacity(); }
+        bool IsInline() const { return storage_.IsInline(); }
 
         void resize(size_t newsize)
         {
-            storage_.resize(newsize, 0);
+            storage_.resize(newsize);
             rpos_ = 0;
             wpos_ = size();
         }
@@ -515,7 +682,7 @@ class ByteBuffer
 
         void drop(uint32 length)
         {
-            storage_.erase(storage_.begin(), storage_.begin() + length);
+            storage_.erase_front(length);
             rpos_ = 0;
             wpos_ = size();
         }
@@ -530,6 +697,17 @@ class ByteBuffer
             return append((const uint8 *)src, cnt * sizeof(T));
         }
 
+        // Grows the buffer by cnt bytes and returns where they start, for writers that fill them in place
+        uint8* AppendSpace(size_t cnt)
+        {
+            if (storage_.size() < wpos_ + cnt)
+                storage_.resize(wpos_ + cnt);
+
+            uint8* data = storage_.data() + wpos_;
+            wpos_ += cnt;
+            return data;
+        }
+
         void append(const uint8 *src, size_t cnt)
         {
             if (!cnt)
@@ -564,21 +742,8 @@ class ByteBuffer
 
         void appendPackGUID(uint64 guid)
         {
-            uint8 packGUID[8+1];
-            packGUID[0] = 0;
-            size_t size = 1;
-            for (uint8 i = 0;guid != 0;++i)
-            {
-                if (guid & 0xFF)
-                {
-                    packGUID[0] |= uint8(1 << i);
-                    packGUID[size] =  uint8(guid & 0xFF);
-                    ++size;
-                }
-
-                guid >>= 8;
-            }
-            append(packGUID, size);
+            uint8 packGUID[PackedGuid::MAX_SIZE];
+            append(packGUID, PackedGuid::Encode(guid, packGUID));
         }
 
         void AppendPackedTime(time_t time)
@@ -605,9 +770,47 @@ class ByteBuffer
         void hexlike() const;
 
     protected:
+        void WriteBitChunk(uint64 value, size_t bits)
+        {
+            if (!bits)
+                return;
+
+            uint32 pending = 8 - uint32(bitpos_);
+            uint64 accumulator = ((uint64(curbitval_) >> bitpos_) << bits) | (value & ((uint64(1) << bits) - 1));
+            uint32 total = pending + uint32(bits);
+
+            uint8 bytes[8];
+            size_t count = 0;
+
+            while (total >= 8)
+            {
+                total -= 8;
+                bytes[count++] = uint8(accumulator >> total);
+            }
+
+            if (count)
+                append(bytes, count);
+
+            bitpos_ = 8 - total;
+            curbitval_ = total ? uint8(accumulator << (8 - total)) : 0;
+        }
+
+        bool SetReadError()
+        {
+            readError_ = true;
+            return false;
+        }
+
+        template <typename T> bool SetReadError(T& value)
+        {
+            value = T();
+            return SetReadError();
+        }
+
         size_t rpos_, wpos_, bitpos_;
         uint8 curbitval_;
-        std::vector<uint8> storage_;
+        bool readError_;
+        ByteStorage storage_;
 };
 
 template <typename T>
@@ -689,6 +892,20 @@ inline ByteBuffer &operator>>(ByteBuffer &b, std::map<K, V> &m)
     return b;
 }
 
+inline ByteBuffer &operator<<(ByteBuffer &b, PackedGuid const& guid)
+{
+    b.append(guid.contents(), guid.size());
+    return b;
+}
+
+inline ByteBuffer &operator>>(ByteBuffer &b, PackedGuidReader const& guid)
+{
+    uint64 value;
+    b.readPackGUID(value);
+    guid.GuidPtr->Set(value);
+    return b;
+}
+
 template<> inline std::string ByteBuffer::read<std::string>()
 {
     std::string tmp;
@@ -699,8 +916,7 @@ template<> inline std::string ByteBuffer::read<std::string>()
 template<>
 inline void ByteBuffer::read_skip<char*>()
 {
-    std::string temp;
-    *this >> temp;
+    ReadCString();
 }
 
 template<>
@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "ByteBuffer.h"
+
+// Read-only cursor over memory it does not own. It mirrors the read side of ByteBuffer
+// (throwing reads, checked TryRead reads with a sticky error flag, strings and packed
+// guids), so a parser can work on a socket buffer, a slice of a packet or any other
+// region without copying it into a ByteBuffer first. The memory has to outlive the reader.
+class ByteReader
+{
+    public:
+        ByteReader() : data_(nullptr), size_(0), rpos_(0), readError_(false) { }
+
+        ByteReader(uint8 const* data, size_t size) : data_(data), size_(size), rpos_(0), readError_(false) { }
+
+        // Views the unread part of the buffer
+        explicit ByteReader(ByteBuffer const& buffer) : data_(nullptr), size_(0), rpos_(0), readError_(false)
+        {
+            if (buffer.rpos() < buffer.size())
+            {
+                data_ = buffer.contents() + buffer.rpos();
+                size_ = buffer.size() - buffer.rpos();
+            }
+        }
+
+        uint8 const* contents() const { return data_; }
+        size_t size() const { return size_; }
+        size_t rpos() const { return rpos_; }
+        size_t remaining() const { return rpos_ < size_ ? size_ - rpos_ : 0; }
+        bool empty() const { return size_ == 0; }
+
+        size_t rpos(size_t pos)
+        {
+            rpos_ = pos;
+            return rpos_;
+        }
+
+        void rfinish() { rpos_ = size_; }
+
+        template <typename T> T read()
+        {
+            T r = read<T>(rpos_);
+            rpos_ += sizeof(T);
+            return r;
+        }
+
+        template <typename T> T read(size_t pos) const
+        {
+            if (pos + sizeof(T) > size_)
+                throw ByteBufferPositionException(false, pos, size_, sizeof(T));
+
+            T val;
+            std::memcpy(&val, data_ + pos, sizeof(T));
+            EndianConvert(val);
+            return val;
+        }
+
+        void read(uint8* dest, size_t len)
+        {
+            if (rpos_ + len > size_)
+                throw ByteBufferPositionException(false, rpos_, size_, len);
+
+            if (len)
+                std::memcpy(dest, data_ + rpos_, len);
+            rpos_ += len;
+        }
+
+        template <typename T> void read_skip() { read_skip(sizeof(T)); }
+
+        void read_skip(size_t skip)
+        {
+            if (rpos_ + skip > size_)
+                throw ByteBufferPositionException(false, rpos_, size_, skip);
+            rpos_ += skip;
+        }
+
+        // Splits the next len bytes off into their own reader and skips them here
+        ByteReader Slice(size_t len)
+        {
+            if (rpos_ + len > size_)
+                throw ByteBufferPositionException(false, rpos_, size_, len);
+
+            ByteReader slice(data_ + rpos_, len);
+            rpos_ += len;
+            return slice;
+        }
+
+        void readPackGUID(uint64& guid)
+        {
+            size_t length = PackedGuid::Decode(data_ + rpos_, remaining(), guid);
+            if (!length)
+                throw ByteBufferPositionException(false, rpos_, size_, 1);
+
+            rpos_ += length;
+        }
+
+        std::string ReadString(uint32 length)
+        {
+            if (rpos_ + length > size_)
+                throw ByteBufferPositionException(false, rpos_, size_, length);
+
+            char const* begin = (char const*)data_ + rpos_;
+            char const* end = length ? (char const*)std::memchr(begin, 0, length) : nullptr;
+            rpos_ += length;
+
+            return std::string(begin, end ? end : begin + length);
+        }
+
+        // Same tolerance as ByteBuffer::ReadCString, a missing terminator ends the view at the end
+        StringView ReadCString()
+        {
+            if (rpos_ >= size_)
+                return StringView();
+
+            char const* begin = (char const*)data_ + rpos_;
+            char const* end = (char const*)std::memchr(begin, 0, size_ - rpos_);
+
+            if (!end)
+            {
+                StringView view(begin, size_ - rpos_);
+                rpos_ = size_;
+                return view;
+            }
+
+            rpos_ += (end - begin) + 1;
+            return StringView(begin, end - begin);
+        }
+
+        ByteReader& operator>>(bool& value)
+        {
+            value = read<char>() > 0;
+            return *this;
+        }
+
+        ByteReader& operator>>(uint8& value) { value = read<uint8>(); return *this; }
+        ByteReader& operator>>(uint16& value) { value = read<uint16>(); return *this; }
+        ByteReader& operator>>(uint32& value) { value = read<uint32>(); return *this; }
+        ByteReader& operator>>(uint64& value) { value = read<uint64>(); return *this; }
+        ByteReader& operator>>(int8& value) { value = read<int8>(); return *this; }
+        ByteReader& operator>>(int16& value) { value = read<int16>(); return *this; }
+        ByteReader& operator>>(int32& value) { value = read<int32>(); return *this; }
+        ByteReader& operator>>(int64& value) { value = read<int64>(); return *this; }
+        ByteReader& operator>>(float& value) { value = read<float>(); return *this; }
+        ByteReader& operator>>(double& value) { value = read<double>(); return *this; }
+
+        ByteReader& operator>>(std::string& value)
+        {
+            StringView view = ReadCString();
+            value.assign(view.data(), view.size());
+            return *this;
+        }
+
+        ByteReader& operator>>(ObjectGuid& guid)
+        {
+            guid = read<uint64>();
+            return *this;
+        }
+
+        ByteReader& operator>>(PackedGuidReader const& guid)
+        {
+            uint64 value;
+            readPackGUID(value);
+            guid.GuidPtr->Set(value);
+            return *this;
+        }
+
+        // Checked reads, same contract as their ByteBuffer counterparts
+        bool HasReadError() const { return readError_; }
+        void ClearReadError() { readError_ = false; }
+
+        template <typename T> bool TryRead(T& value)
+        {
+            if (readError_ || rpos_ + sizeof(T) > size_)
+                return SetReadError(value);
+
+            std::memcpy(&value, data_ + rpos_, sizeof(T));
+            EndianConvert(value);
+            rpos_ += sizeof(T);
+            return true;
+        }
+
+        bool TryRead(bool& value)
+        {
+            uint8 raw;
+            if (!TryRead(raw))
+                return SetReadError(value);
+
+            value = raw > 0;
+            return true;
+        }
+
+        bool TryRead(ObjectGuid& guid)
+        {
+            uint64 raw;
+            if (!TryRead(raw))
+            {
+                guid.Clear();
+                return false;
+            }
+
+            guid.Set(raw);
+            return true;
+        }
+
+        bool TryRead(StringView& value)
+        {
+            if (readError_ || rpos_ >= size_)
+                return SetReadError(value);
+
+            char const* begin = (char const*)data_ + rpos_;
+            char const* end = (char const*)std::memchr(begin, 0, size_ - rpos_);
+
+            if (!end)
+                return SetReadError(value);
+
+            value = StringView(begin, end - begin);
+            rpos_ += (end - begin) + 1;
+            return true;
+        }
+
+        bool TryRead(std::string& value)
+        {
+            StringView view;
+            bool result = TryRead(view);
+            value.assign(view.data(), view.size());
+            return result;
+        }
+
+        bool TryReadSkip(size_t skip)
+        {
+            if (readError_ || rpos_ + skip > size_)
+                return SetReadError();
+
+            rpos_ += skip;
+            return true;
+        }
+
+        template <typename T> bool TryReadSkip() { return TryReadSkip(sizeof(T)); }
+
+        bool TryReadPackGUID(uint64& guid)
+        {
+            size_t length = readError_ ? 0 : PackedGuid::Decode(data_ + rpos_, remaining(), guid);
+            if (!length)
+                return SetReadError(guid);
+
+            rpos_ += length;
+            return true;
+        }
+
+    private:
+        bool SetReadError()
+        {
+            readError_ = true;
+            return false;
+        }
+
+        template <typename T> bool SetReadError(T& value)
+        {
+            value = T();
+            return SetReadError();
+        }
+
+        uint8 const* data_;
+        size_t size_;
+        size_t rpos_;
+        bool readError_;
+};
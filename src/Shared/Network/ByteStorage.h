@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Define.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// Byte storage of ByteBuffer. Up to INLINE_SIZE bytes live inside the object itself,
+// so small packets are built and copied without touching the allocator, larger ones
+// spill to a heap block that grows geometrically like a vector. clear() keeps the
+// capacity, as the packet pool relies on it.
+class ByteStorage
+{
+    public:
+        static const size_t INLINE_SIZE = 32;
+
+        ByteStorage() : data_(inline_), size_(0), capacity_(INLINE_SIZE)
+        {
+        }
+
+        ByteStorage(ByteStorage const& other) : data_(inline_), size_(0), capacity_(INLINE_SIZE)
+        {
+            Assign(other);
+        }
+
+        ByteStorage(ByteStorage&& other) : data_(inline_), size_(0), capacity_(INLINE_SIZE)
+        {
+            Take(other);
+        }
+
+        ~ByteStorage()
+        {
+            if (!IsInline())
+                std::free(data_);
+        }
+
+        ByteStorage& operator=(ByteStorage const& other)
+        {
+            if (this != &other)
+                Assign(other);
+
+            return *this;
+        }
+
+        ByteStorage& operator=(ByteStorage&& other)
+        {
+            if (this != &other)
+                Take(other);
+
+            return *this;
+        }
+
+        uint8* data() { return data_; }
+        uint8 const* data() const { return data_; }
+
+        uint8& operator[](size_t pos) { return data_[pos]; }
+        uint8 const& operator[](size_t pos) const { return data_[pos]; }
+
+        size_t size() const { return size_; }
+        size_t capacity() const { return capacity_; }
+        bool empty() const { return size_ == 0; }
+        bool IsInline() const { return data_ == inline_; }
+
+        void clear() { size_ = 0; }
+
+        void reserve(size_t capacity)
+        {
+            if (capacity > capacity_)
+                Grow(capacity);
+        }
+
+        // New bytes are zeroed, same as std::vector<uint8>::resize
+        void resize(size_t size)
+        {
+            if (size > capacity_)
+                Grow(std::max(size, capacity_ * 2));
+
+            if (size > size_)
+                std::memset(data_ + size_, 0, size - size_);
+
+            size_ = size;
+        }
+
+        // Removes count bytes from the front
+        void erase_front(size_t count)
+        {
+            count = std::min(count, size_);
+            std::memmove(data_, data_ + count, size_ - count);
+            size_ -= count;
+        }
+
+    private:
+        void Grow(size_t capacity)
+        {
+            uint8* data = static_cast<uint8*>(IsInline() ? std::malloc(capacity) : std::realloc(data_, capacity));
+
+            if (!data)
+                throw std::bad_alloc();
+
+            if (IsInline())
+                std::memcpy(data, inline_, size_);
+
+            data_ = data;
+            capacity_ = capacity;
+        }
+
+        void Assign(ByteStorage const& other)
+        {
+            size_ = 0;
+            reserve(other.size_);
+
+            if (other.size_)
+                std::memcpy(data_, other.data_, other.size_);
+            size_ = other.size_;
+        }
+
+        // Steals a heap block, inline bytes are copied into whatever this storage already has
+        void Take(ByteStorage& other)
+        {
+            if (other.IsInline())
+            {
+                Assign(other);
+                other.size_ = 0;
+                return;
+            }
+
+            if (!IsInline())
+                std::free(data_);
+
+            data_ = other.data_;
+            size_ = other.size_;
+            capacity_ = other.capacity_;
+
+            other.data_ = other.inline_;
+            other.size_ = 0;
+            other.capacity_ = INLINE_SIZE;
+        }
+
+        uint8* data_;
+        size_t size_;
+        size_t capacity_;
+        uint8 inline_[INLINE_SIZE];
+};
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Define.h"
+#include <algorithm>
+#include <vector>
+#include <cstring>
+
+// Receive buffer filled by large reads and consumed by a framing parser.
+// Unread bytes are moved back to the front (Normalize) instead of wrapping
+// around, so every frame stays contiguous and can be decrypted in place.
+class MessageBuffer
+{
+    public:
+        const static size_t DEFAULT_SIZE = 0x4000;
+
+        MessageBuffer() : rpos_(0), wpos_(0), storage_(DEFAULT_SIZE)
+        {
+        }
+
+        explicit MessageBuffer(size_t size) : rpos_(0), wpos_(0), storage_(size)
+        {
+        }
+
+        void Reset()
+        {
+            rpos_ = wpos_ = 0;
+        }
+
+        uint8* GetReadPointer() { return &storage_[rpos_]; }
+        uint8* GetWritePointer() { return &storage_[wpos_]; }
+
+        void ReadCompleted(size_t bytes) { rpos_ += bytes; }
+        void WriteCompleted(size_t bytes) { wpos_ += bytes; }
+
+        size_t GetActiveSize() const { return wpos_ - rpos_; }
+        size_t GetRemainingSpace() const { return storage_.size() - wpos_; }
+        size_t GetBufferSize() const { return storage_.size(); }
+
+        // Grows or shrinks the storage, unread bytes beyond the new size are lost
+        void Resize(size_t size)
+        {
+            storage_.resize(size);
+            rpos_ = std::min(rpos_, size);
+            wpos_ = std::min(wpos_, size);
+        }
+
+        // Moves the unread bytes to the beginning of the buffer
+        void Normalize()
+        {
+            if (!rpos_)
+                return;
+
+            if (rpos_ != wpos_)
+                std::memmove(&storage_[0], &storage_[rpos_], GetActiveSize());
+
+            wpos_ -= rpos_;
+            rpos_ = 0;
+        }
+
+    private:
+        size_t rpos_;
+        size_t wpos_;
+        std::vector<uint8> storage_;
+};
@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "ByteReader.h"
+#include <type_traits>
+
+// Packet layouts declared once as a list of fields bound to struct members:
+//
+//     typedef PacketSchema<
+//         SCHEMA_FIELD(AuthChallenge, ServerSeed),
+//         SCHEMA_BYTES(AuthChallenge, EncryptionSeed)
+//     > AuthChallengeSchema;
+//
+// Reading checks the remaining size once for every run of fixed size fields and then
+// copies them without further checks, only variable fields (strings) check on their own.
+// Writing computes the exact size first and fills the bytes in place. Reads never throw,
+// they return false when the data is truncated.
+
+// Wire representation of a member, bool is read as a byte so any non-zero value is true
+template <typename T> struct SchemaWire { typedef T Type; };
+template <> struct SchemaWire<bool> { typedef uint8 Type; };
+
+// Scalar, enum or ObjectGuid member
+template <typename Class, typename T, T Class::*Member>
+struct SchemaField
+{
+    typedef typename SchemaWire<T>::Type Wire;
+
+    static const bool IsFixed = true;
+    static const size_t Size = sizeof(Wire);
+
+    template <typename Owner> static bool Read(uint8 const*& data, uint8 const* /*end*/, Owner& owner)
+    {
+        Wire value;
+        std::memcpy(&value, data, sizeof(Wire));
+        EndianConvert(value);
+        owner.*Member = T(value);
+        data += sizeof(Wire);
+        return true;
+    }
+
+    template <typename Owner> static size_t GetSize(Owner const& /*owner*/) { return sizeof(Wire); }
+
+    template <typename Owner> static void Write(uint8*& data, Owner const& owner)
+    {
+        Wire value = Wire(owner.*Member);
+        EndianConvert(value);
+        std::memcpy(data, &value, sizeof(Wire));
+        data += sizeof(Wire);
+    }
+};
+
+// Raw byte array member, copied as is
+template <typename Class, typename T, T Class::*Member>
+struct SchemaBytes
+{
+    static const bool IsFixed = true;
+    static const size_t Size = sizeof(T);
+
+    template <typename Owner> static bool Read(uint8 const*& data, uint8 const* /*end*/, Owner& owner)
+    {
+        std::memcpy(&(owner.*Member), data, sizeof(T));
+        data += sizeof(T);
+        return true;
+    }
+
+    template <typename Owner> static size_t GetSize(Owner const& /*owner*/) { return sizeof(T); }
+
+    template <typename Owner> static void Write(uint8*& data, Owner const& owner)
+    {
+        std::memcpy(data, &(owner.*Member), sizeof(T));
+        data += sizeof(T);
+    }
+};
+
+// NUL terminated std::string member, a missing terminator fails the read
+template <typename Class, std::string Class::*Member>
+struct SchemaString
+{
+    static const bool IsFixed = false;
+    static const size_t Size = 0;
+
+    template <typename Owner> static bool Read(uint8 const*& data, uint8 const* end, Owner& owner)
+    {
+        if (data >= end)
+            return false;
+
+        uint8 const* terminator = static_cast<uint8 const*>(std::memchr(data, 0, end - data));
+        if (!terminator)
+            return false;
+
+        (owner.*Member).assign(reinterpret_cast<char const*>(data), terminator - data);
+        data = terminator + 1;
+        return true;
+    }
+
+    template <typename Owner> static size_t GetSize(Owner const& owner) { return (owner.*Member).size() + 1; }
+
+    template <typename Owner> static void Write(uint8*& data, Owner const& owner)
+    {
+        std::string const& value = owner.*Member;
+        std::memcpy(data, value.data(), value.size());
+        data[value.size()] = 0;
+        data += value.size() + 1;
+    }
+};
+
+// Bytes that are skipped when reading and written as zero
+template <size_t Length>
+struct SchemaPad
+{
+    static const bool IsFixed = true;
+    static const size_t Size = Length;
+
+    template <typename Owner> static bool Read(uint8 const*& data, uint8 const* /*end*/, Owner& /*owner*/)
+    {
+        data += Length;
+        return true;
+    }
+
+    template <typename Owner> static size_t GetSize(Owner const& /*owner*/) { return Length; }
+
+    template <typename Owner> static void Write(uint8*& data, Owner const& /*owner*/)
+    {
+        std::memset(data, 0, Length);
+        data += Length;
+    }
+};
+
+// Member struct laid out by a fixed size schema of its own
+template <typename Class, typename T, T Class::*Member, typename Schema>
+struct SchemaNested
+{
+    static_assert(Schema::IsFixed, "Nested schemas must have a fixed size");
+
+    static const bool IsFixed = true;
+    static const size_t Size = Schema::Size;
+
+    template <typename Owner> static bool Read(uint8 const*& data, uint8 const* end, Owner& owner)
+    {
+        return Schema::ReadRun(data, end, owner.*Member);
+    }
+
+    template <typename Owner> static size_t GetSize(Owner const& /*owner*/) { return Schema::Size; }
+
+    template <typename Owner> static void Write(uint8*& data, Owner const& owner)
+    {
+        Schema::Write(data, owner.*Member);
+    }
+};
+
+// Array member whose elements are laid out by a fixed size schema
+template <typename Class, typename T, T Class::*Member, typename Schema>
+struct SchemaArray
+{
+    static_assert(std::is_array<T>::value && Schema::IsFixed, "Array schemas need an array member and a fixed size element schema");
+
+    static const size_t Count = std::extent<T>::value;
+    static const bool IsFixed = true;
+    static const size_t Size = Count * Schema::Size;
+
+    template <typename Owner> static bool Read(uint8 const*& data, uint8 const* end, Owner& owner)
+    {
+        for (size_t i = 0; i < Count; ++i)
+        {
+            if (!Schema::ReadRun(data, end, (owner.*Member)[i]))
+                return false;
+        }
+
+        return true;
+    }
+
+    template <typename Owner> static size_t GetSize(Owner const& /*owner*/) { return Count * Schema::Size; }
+
+    template <typename Owner> static void Write(uint8*& data, Owner const& owner)
+    {
+        for (size_t i = 0; i < Count; ++i)
+            Schema::Write(data, (owner.*Member)[i]);
+    }
+};
+
+#define SCHEMA_FIELD(Class, member) SchemaField<Class, decltype(Class::member), &Class::member>
+#define SCHEMA_BYTES(Class, member) SchemaBytes<Class, decltype(Class::member), &Class::member>
+#define SCHEMA_STRING(Class, member) SchemaString<Class, &Class::member>
+#define SCHEMA_NESTED(Class, member, Schema) SchemaNested<Class, decltype(Class::member), &Class::member, Schema>
+#define SCHEMA_ARRAY(Class, member, Schema) SchemaArray<Class, decltype(Class::member), &Class::member, Schema>
+
+// Size of the fixed fields up to the next variable one
+template <typename... Fields> struct SchemaRun;
+
+template <> struct SchemaRun<>
+{
+    static const size_t Size = 0;
+};
+
+template <typename Field, typename... Rest> struct SchemaRun<Field, Rest...>
+{
+    static const size_t Size = Field::IsFixed ? Field::Size + SchemaRun<Rest...>::Size : 0;
+};
+
+template <typename... Fields> struct SchemaFields;
+
+template <> struct SchemaFields<>
+{
+    static const bool IsFixed = true;
+    static const size_t Size = 0;
+
+    template <typename Owner> static bool Read(uint8 const*&, uint8 const*, Owner&) { return true; }
+    template <typename Owner> static bool ReadRun(uint8 const*&, uint8 const*, Owner&) { return true; }
+    template <typename Owner> static size_t GetSize(Owner const&) { return 0; }
+    template <typename Owner> static void Write(uint8*&, Owner const&) { }
+};
+
+template <typename Field, typename... Rest> struct SchemaFields<Field, Rest...>
+{
+    typedef SchemaFields<Rest...> Next;
+
+    static const bool IsFixed = Field::IsFixed && Next::IsFixed;
+    static const size_t Size = Field::Size + Next::Size;
+
+    // Starts a run: checks the size of all fixed fields up to the next variable one
+    template <typename Owner> static bool Read(uint8 const*& data, uint8 const* end, Owner& owner)
+    {
+        if (!Field::IsFixed)
+            return Field::Read(data, end, owner) && Next::Read(data, end, owner);
+
+        if (size_t(end - data) < SchemaRun<Field, Rest...>::Size)
+            return false;
+
+        return ReadRun(data, end, owner);
+    }
+
+    // Continues a run whose size is already checked
+    template <typename Owner> static bool ReadRun(uint8 const*& data, uint8 const* end, Owner& owner)
+    {
+        if (!Field::IsFixed)
+            return Read(data, end, owner);
+
+        // The size is known to fit, but a field may still reject what it read
+        return Field::Read(data, end, owner) && Next::ReadRun(data, end, owner);
+    }
+
+    template <typename Owner> static size_t GetSize(Owner const& owner)
+    {
+        return Field::GetSize(owner) + Next::GetSize(owner);
+    }
+
+    template <typename Owner> static void Write(uint8*& data, Owner const& owner)
+    {
+        Field::Write(data, owner);
+        Next::Write(data, owner);
+    }
+};
+
+template <typename... Fields>
+class PacketSchema : public SchemaFields<Fields...>
+{
+    public:
+        typedef SchemaFields<Fields...> Base;
+
+        // Size of a fixed layout, or the minimum size when it has strings
+        static const size_t MinSize = Base::Size;
+
+        template <typename Owner> static bool Read(ByteBuffer& buffer, Owner& owner)
+        {
+            size_t rpos = std::min(buffer.rpos(), buffer.size());
+            uint8 const* begin = buffer.contents() + rpos;
+            uint8 const* data = begin;
+
+            if (!Base::Read(data, buffer.contents() + buffer.size(), owner))
+                return false;
+
+            buffer.rpos(rpos + (data - begin));
+            return true;
+        }
+
+        template <typename Owner> static bool Read(ByteReader& reader, Owner& owner)
+        {
+            size_t rpos = std::min(reader.rpos(), reader.size());
+            uint8 const* begin = reader.contents() + rpos;
+            uint8 const* data = begin;
+
+            if (!Base::Read(data, reader.contents() + reader.size(), owner))
+                return false;
+
+            reader.rpos(rpos + (data - begin));
+            return true;
+        }
+
+        template <typename Owner> static void Write(ByteBuffer& buffer, Owner const& owner)
+        {
+            size_t size = Base::GetSize(owner);
+            uint8* data = buffer.AppendSpace(size);
+            Base::Write(data, owner);
+        }
+
+        using Base::Read;
+        using Base::Write;
+};
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Resolver.h"
+#include <cstring>
+#include <memory>
+#include <thread>
+
+#ifndef _WIN32
+    #include <sys/types.h>
+    #include <netdb.h>
+#endif
+
+using namespace std::chrono;
+
+static const uint32 CacheTime = 300;                    // Seconds
+
+Resolver::Resolver() : queue_(new Queue())
+{
+}
+
+Resolver* Resolver::instance()
+{
+    static Resolver resolver;
+    return &resolver;
+}
+
+AddressList Resolver::Lookup(std::string const& host, std::string const& port)
+{
+    AddressList addresses;
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo* serverinfo = nullptr;
+
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &serverinfo))
+        return addresses;
+
+    for (struct addrinfo* tmp = serverinfo; tmp != nullptr; tmp = tmp->ai_next)
+    {
+        if (tmp->ai_family != AF_INET && tmp->ai_family != AF_INET6)
+            continue;
+
+        SocketAddress address;
+        memset(&address.storage, 0, sizeof(address.storage));
+        memcpy(&address.storage, tmp->ai_addr, tmp->ai_addrlen);
+        address.length = socklen_t(tmp->ai_addrlen);
+        addresses.push_back(address);
+    }
+
+    freeaddrinfo(serverinfo);
+    return addresses;
+}
+
+Resolver::Entry Resolver::Acquire(std::string const& host, std::string const& port)
+{
+    std::string key = host + ":" + port;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    steady_clock::time_point now = steady_clock::now();
+
+    auto itr = cache_.find(key);
+
+    // Keep pending lookups and fresh results, retry failures
+    if (itr != cache_.end())
+    {
+        std::shared_future<AddressList>& cached = itr->second.result;
+        bool ready = cached.wait_for(seconds(0)) == std::future_status::ready;
+
+        if (!ready || (now < itr->second.expiry && !cached.get().empty()))
+            return itr->second;
+    }
+
+    Request request;
+    request.host = host;
+    request.port = port;
+    request.promise.reset(new std::promise<AddressList>());
+    request.pending.reset(new Pending());
+
+    Entry& entry = cache_[key];
+    entry.result = request.promise->get_future().share();
+    entry.pending = request.pending;
+    entry.expiry = now + seconds(CacheTime);
+
+    // Queued behind the running lookups once MAX_THREADS of them are busy. The threads
+    // are detached, so a hanging lookup never blocks a destructor.
+    bool spawn = false;
+
+    {
+        std::lock_guard<std::mutex> queueLock(queue_->mutex);
+        queue_->requests.push_back(request);
+
+        if (queue_->threads < MAX_THREADS)
+        {
+            ++queue_->threads;
+            spawn = true;
+        }
+    }
+
+    if (spawn)
+        std::thread(&Resolver::RunLookups, queue_).detach();
+
+    return entry;
+}
+
+void Resolver::RunLookups(std::shared_ptr<Queue> queue)
+{
+    while (true)
+    {
+        Request request;
+
+        {
+            std::lock_guard<std::mutex> lock(queue->mutex);
+
+            if (queue->requests.empty())
+            {
+                --queue->threads;
+                return;
+            }
+
+            request = queue->requests.front();
+            queue->requests.pop_front();
+        }
+
+        AddressList addresses = Lookup(request.host, request.port);
+        std::vector<Callback> callbacks;
+
+        {
+            std::lock_guard<std::mutex> lock(request.pending->mutex);
+            request.pending->done = true;
+            callbacks.swap(request.pending->callbacks);
+            request.promise->set_value(addresses);
+        }
+
+        for (Callback const& callback : callbacks)
+            callback(addresses);
+    }
+}
+
+bool Resolver::Resolve(std::string const& host, std::string const& port, uint32 timeout, AddressList& addresses)
+{
+    std::shared_future<AddressList> result = Acquire(host, port).result;
+
+    if (result.wait_for(milliseconds(timeout)) != std::future_status::ready)
+        return false;
+
+    addresses = result.get();
+    return !addresses.empty();
+}
+
+void Resolver::Resolve(std::string const& host, std::string const& port, Callback callback)
+{
+    Entry entry = Acquire(host, port);
+
+    {
+        std::lock_guard<std::mutex> lock(entry.pending->mutex);
+
+        if (!entry.pending->done)
+        {
+            entry.pending->callbacks.push_back(std::move(callback));
+            return;
+        }
+    }
+
+    callback(entry.result.get());
+}
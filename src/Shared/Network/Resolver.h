@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Define.h"
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+    #include <WinSock2.h>
+    #include <WS2tcpip.h>
+#else
+    #include <sys/socket.h>
+#endif
+
+struct SocketAddress
+{
+    sockaddr_storage storage;
+    socklen_t length;
+
+    int32 GetFamily() const { return storage.ss_family; }
+    sockaddr const* Get() const { return reinterpret_cast<sockaddr const*>(&storage); }
+};
+
+typedef std::vector<SocketAddress> AddressList;
+
+// Resolves host names on a few background threads. Concurrent requests for the same
+// host share one lookup and successful results are cached for a few minutes,
+// so a mass reconnect costs a single query.
+class Resolver
+{
+    public:
+        const static uint32 MAX_THREADS = 4;
+
+        static Resolver* instance();
+
+        // Returns false if the lookup failed or didn't finish in time, a late
+        // result still ends up in the cache
+        bool Resolve(std::string const& host, std::string const& port, uint32 timeout, AddressList& addresses);
+
+        typedef std::function<void(AddressList const&)> Callback;
+
+        // Never blocks, the callback gets the addresses (empty if the lookup failed) on the
+        // lookup thread, or right away on the caller's if the result is already known
+        void Resolve(std::string const& host, std::string const& port, Callback callback);
+
+    private:
+        Resolver();
+
+        // Shared by a cache entry and the thread doing its lookup
+        struct Pending
+        {
+            Pending() : done(false) { }
+
+            std::mutex mutex;
+            std::vector<Callback> callbacks;
+            bool done;
+        };
+
+        struct Entry
+        {
+            std::shared_future<AddressList> result;
+            std::shared_ptr<Pending> pending;
+            std::chrono::steady_clock::time_point expiry;
+        };
+
+        struct Request
+        {
+            std::string host;
+            std::string port;
+            std::shared_ptr<std::promise<AddressList>> promise;
+            std::shared_ptr<Pending> pending;
+        };
+
+        // Lookups waiting for a thread. Owned by the threads too, a lookup that never
+        // returns must not keep the process from exiting or touch a destroyed Resolver.
+        struct Queue
+        {
+            Queue() : threads(0) { }
+
+            std::mutex mutex;
+            std::deque<Request> requests;
+            uint32 threads;
+        };
+
+        // Returns the cached or pending lookup of the host, starts a new one if there is none
+        Entry Acquire(std::string const& host, std::string const& port);
+
+        static AddressList Lookup(std::string const& host, std::string const& port);
+
+        // Runs queued lookups until none is left, then the thread exits
+        static void RunLookups(std::shared_ptr<Queue> queue);
+
+        std::mutex mutex_;
+        std::map<std::string, Entry> cache_;
+        std::shared_ptr<Queue> queue_;
+};
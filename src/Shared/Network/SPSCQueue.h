@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Define.h"
+#include <atomic>
+#include <cassert>
+#include <memory>
+
+// Bounded lock-free queue for exactly one producer and one consumer thread.
+// The producer only writes tail_ and the consumer only writes head_, each of
+// them is padded to its own cache line so the two threads don't false share.
+template <typename T>
+class SPSCQueue
+{
+    public:
+        // The capacity is rounded up to a power of two
+        explicit SPSCQueue(size_t capacity) : head_(0), tail_(0)
+        {
+            size_t size = 2;
+
+            while (size < capacity)
+                size <<= 1;
+
+            mask_ = size - 1;
+            slots_.reset(new T[size]);
+        }
+
+        SPSCQueue(SPSCQueue const&) = delete;
+        SPSCQueue& operator=(SPSCQueue const&) = delete;
+
+        // Producer: moves from value only if there was room for it
+        bool Push(T& value)
+        {
+            size_t tail = tail_.load(std::memory_order_relaxed);
+
+            if (tail - head_.load(std::memory_order_acquire) > mask_)
+                return false;
+
+            slots_[tail & mask_] = std::move(value);
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer
+        bool Pop(T& value)
+        {
+            size_t head = head_.load(std::memory_order_relaxed);
+
+            if (head == tail_.load(std::memory_order_acquire))
+                return false;
+
+            value = std::move(slots_[head & mask_]);
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer: destroys every queued element
+        void Clear()
+        {
+            // Every Pop releases the element popped before it
+            T value;
+
+            while (Pop(value))
+                ;
+        }
+
+        bool IsEmpty() const { return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire); }
+        size_t GetCapacity() const { return mask_ + 1; }
+
+    private:
+        const static size_t CACHE_LINE_SIZE = 64;
+
+        std::atomic<size_t> head_;
+        char headPadding_[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+        std::atomic<size_t> tail_;
+        char tailPadding_[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+
+        size_t mask_;
+        std::unique_ptr<T[]> slots_;
+};
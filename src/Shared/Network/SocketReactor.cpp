@@ -0,0 +1,459 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SocketReactor.h"
+#include "AsyncSocket.h"
+#include "Common.h"
+#include "Cryptography/RC4.h"
+#include <algorithm>
+
+#ifdef __linux__
+    #include <sys/epoll.h>
+    #include <sys/eventfd.h>
+    #include <unistd.h>
+    #include <errno.h>
+#elif defined(_WIN32)
+    #define poll WSAPoll
+    typedef WSAPOLLFD pollfd;
+#else
+    #include <poll.h>
+#endif
+
+struct SocketReactor::Lane
+{
+    Lane() : sockets(0) { }
+
+    std::thread thread;
+    std::recursive_mutex mutex;             // Held while a batch is dispatched and while sockets are added or removed
+    std::mutex requestMutex;                // Held to queue read requests and re-arm sockets, never across a callback
+    std::atomic<uint32> sockets;
+    std::vector<AsyncSocket*> removed;      // Sockets removed after the current batch was polled
+    std::vector<AsyncSocket*> readRequests; // Sockets whose OnReadable is called without a readiness event
+    std::vector<AsyncSocket*> serviced;     // Sockets that had callbacks in the current batch
+    std::vector<RC4*> ciphers;              // Scratch for RefillKeystreams
+
+#ifdef __linux__
+    int epollFd;
+    int wakeFd;
+#else
+    std::vector<AsyncSocket*> members;
+#endif
+};
+
+#ifdef __linux__
+    static const uint32 SocketEvents = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+#endif
+
+SocketReactor::SocketReactor() : running_(false), stopped_(false), laneCount_(0)
+{
+}
+
+SocketReactor::~SocketReactor()
+{
+    Stop();
+
+#ifdef __linux__
+    for (uint32 i = 0; i < laneCount_; ++i)
+    {
+        close(lanes_[i]->wakeFd);
+        close(lanes_[i]->epollFd);
+    }
+#endif
+}
+
+SocketReactor* SocketReactor::instance()
+{
+    static SocketReactor reactor;
+    return &reactor;
+}
+
+void SocketReactor::Start(uint32 threadCount)
+{
+    std::lock_guard<std::mutex> lock(startMutex_);
+
+    if (running_)
+        return;
+
+    // The lanes outlive a Stop, sockets look them up by index without any lock
+    if (!laneCount_)
+        CreateLanes(threadCount);
+
+    running_ = true;
+    stopped_ = false;
+
+    for (uint32 i = 0; i < laneCount_; ++i)
+        lanes_[i]->thread = std::thread(&SocketReactor::Run, this, lanes_[i].get());
+}
+
+void SocketReactor::CreateLanes(uint32 count)
+{
+    uint32 maxThreads = MAX_THREADS;
+
+    if (!count)
+        count = std::max(1u, std::min(std::thread::hardware_concurrency(), maxThreads));
+
+    count = std::min(count, maxThreads);
+
+    for (uint32 i = 0; i < count; ++i)
+    {
+        std::unique_ptr<Lane> lane(new Lane());
+
+#ifdef __linux__
+        lane->epollFd = epoll_create1(EPOLL_CLOEXEC);
+        lane->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;
+        epoll_ctl(lane->epollFd, EPOLL_CTL_ADD, lane->wakeFd, &event);
+#endif
+
+        lanes_[i] = std::move(lane);
+    }
+
+    laneCount_ = count;
+}
+
+void SocketReactor::Stop()
+{
+    std::lock_guard<std::mutex> lock(startMutex_);
+
+    if (!running_)
+        return;
+
+    // Set first, an Add that sees the reactor not running knows not to start it
+    stopped_ = true;
+    running_ = false;
+
+    for (uint32 i = 0; i < laneCount_; ++i)
+    {
+        Lane* lane = lanes_[i].get();
+
+#ifdef __linux__
+        uint64 one = 1;
+        if (write(lane->wakeFd, &one, sizeof(one)) != sizeof(one))
+            error("%s", "Couldn't wake up an I/O thread!");
+#endif
+
+        if (lane->thread.joinable())
+            lane->thread.join();
+    }
+}
+
+bool SocketReactor::Add(AsyncSocket* socket)
+{
+    // Only the first use starts the reactor. Waiting on startMutex_ after a Stop could
+    // deadlock with the Stop joining the lane this is called from.
+    if (!running_ && !stopped_)
+        Start();
+
+    if (!running_)
+        return false;
+
+    // Pick the least loaded lane. A socket attached again keeps its lane, so it can
+    // re-attach from its own callback without locking a second lane.
+    uint32 count = laneCount_;
+    uint32 index = 0;
+
+    if (socket->lane_ >= 0 && uint32(socket->lane_) < count)
+        index = uint32(socket->lane_);
+    else
+    {
+        for (uint32 i = 1; i < count; ++i)
+        {
+            if (lanes_[i]->sockets < lanes_[index]->sockets)
+                index = i;
+        }
+    }
+
+    Lane* lane = lanes_[index].get();
+    std::lock_guard<std::recursive_mutex> lock(lane->mutex);
+
+#ifdef __linux__
+    epoll_event event;
+    event.events = SocketEvents;
+    event.data.ptr = socket;
+
+    if (epoll_ctl(lane->epollFd, EPOLL_CTL_ADD, socket->GetHandle(), &event) != 0)
+        return false;
+#else
+    lane->members.push_back(socket);
+#endif
+
+    lane->removed.erase(std::remove(lane->removed.begin(), lane->removed.end(), socket), lane->removed.end());
+    ++lane->sockets;
+
+    socket->wantWrite_ = true;
+    socket->lane_ = int32(index);
+    socket->attached_ = true;
+    return true;
+}
+
+void SocketReactor::Remove(AsyncSocket* socket)
+{
+    int32 index = socket->lane_;
+
+    if (index < 0 || uint32(index) >= laneCount_)
+    {
+        socket->TCPSocket::Disconnect();
+        return;
+    }
+
+    Lane* lane = lanes_[index].get();
+    std::lock_guard<std::recursive_mutex> lock(lane->mutex);
+
+    if (socket->attached_.exchange(false))
+    {
+        {
+            // Requests check attached_ under this lock, none can touch the socket once it is released
+            std::lock_guard<std::mutex> requestLock(lane->requestMutex);
+
+#ifdef __linux__
+            epoll_ctl(lane->epollFd, EPOLL_CTL_DEL, socket->GetHandle(), nullptr);
+#endif
+            lane->readRequests.erase(std::remove(lane->readRequests.begin(), lane->readRequests.end(), socket), lane->readRequests.end());
+        }
+
+#ifndef __linux__
+        lane->members.erase(std::remove(lane->members.begin(), lane->members.end(), socket), lane->members.end());
+#endif
+
+        lane->removed.push_back(socket);
+        --lane->sockets;
+    }
+
+    socket->TCPSocket::Disconnect();
+}
+
+bool SocketReactor::IsRemoved(Lane* lane, AsyncSocket* socket)
+{
+    return std::find(lane->removed.begin(), lane->removed.end(), socket) != lane->removed.end();
+}
+
+void SocketReactor::RequestWrite(AsyncSocket* socket)
+{
+    // A write is already pending, the I/O thread will pick up the new data too
+    if (socket->wantWrite_.exchange(true))
+        return;
+
+#ifdef __linux__
+    int32 index = socket->lane_;
+
+    if (!socket->attached_ || index < 0 || uint32(index) >= laneCount_)
+        return;
+
+    // Doesn't wait for the batch the lane is dispatching. Remove deletes the descriptor
+    // under the same lock, so a socket still attached here is still registered.
+    Lane* lane = lanes_[index].get();
+    std::lock_guard<std::mutex> lock(lane->requestMutex);
+
+    if (!socket->attached_ || socket->lane_ != index)
+        return;
+
+    // Re-arming an edge-triggered descriptor reports EPOLLOUT again if it is writable
+    epoll_event event;
+    event.events = SocketEvents;
+    event.data.ptr = socket;
+    epoll_ctl(lane->epollFd, EPOLL_CTL_MOD, socket->GetHandle(), &event);
+#endif
+}
+
+void SocketReactor::RequestRead(AsyncSocket* socket)
+{
+    int32 index = socket->lane_;
+
+    if (!socket->attached_ || index < 0 || uint32(index) >= laneCount_)
+        return;
+
+    Lane* lane = lanes_[index].get();
+    std::lock_guard<std::mutex> lock(lane->requestMutex);
+
+    if (!socket->attached_ || socket->lane_ != index)
+        return;
+
+    if (std::find(lane->readRequests.begin(), lane->readRequests.end(), socket) != lane->readRequests.end())
+        return;
+
+    lane->readRequests.push_back(socket);
+
+#ifdef __linux__
+    uint64 one = 1;
+    if (write(lane->wakeFd, &one, sizeof(one)) != sizeof(one))
+        error("%s", "Couldn't wake up an I/O thread!");
+#endif
+}
+
+void SocketReactor::ProcessReadRequests(Lane* lane)
+{
+    std::vector<AsyncSocket*> requests;
+
+    {
+        std::lock_guard<std::mutex> lock(lane->requestMutex);
+        requests.swap(lane->readRequests);
+    }
+
+    for (AsyncSocket* socket : requests)
+    {
+        if (!IsRemoved(lane, socket))
+        {
+            socket->OnReadable();
+            lane->serviced.push_back(socket);
+        }
+    }
+}
+
+void SocketReactor::RefillKeystreams(Lane* lane)
+{
+    // A socket serviced by both a readiness event and a read request is listed twice
+    std::sort(lane->serviced.begin(), lane->serviced.end());
+    lane->serviced.erase(std::unique(lane->serviced.begin(), lane->serviced.end()), lane->serviced.end());
+
+    for (AsyncSocket* socket : lane->serviced)
+    {
+        if (!IsRemoved(lane, socket))
+            socket->CollectCiphers(lane->ciphers);
+    }
+
+    RC4::Refill(lane->ciphers.data(), lane->ciphers.size());
+
+    lane->ciphers.clear();
+    lane->serviced.clear();
+}
+
+#ifdef __linux__
+
+void SocketReactor::Run(Lane* lane)
+{
+    const int32 maxEvents = 64;
+    epoll_event events[maxEvents];
+
+    while (running_)
+    {
+        int32 count = epoll_wait(lane->epollFd, events, maxEvents, -1);
+
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            error("%s", "epoll_wait failed, stopping I/O thread!");
+            break;
+        }
+
+        std::lock_guard<std::recursive_mutex> lock(lane->mutex);
+
+        for (int32 i = 0; i < count; ++i)
+        {
+            AsyncSocket* socket = static_cast<AsyncSocket*>(events[i].data.ptr);
+
+            // Wake-up request: stop or read requests
+            if (!socket)
+            {
+                uint64 value;
+                if (read(lane->wakeFd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+                    error("%s", "Couldn't read the wake-up counter of an I/O thread!");
+
+                continue;
+            }
+
+            if (IsRemoved(lane, socket))
+                continue;
+
+            lane->serviced.push_back(socket);
+
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                socket->OnReadable();
+
+            // The socket may have been disconnected and even destroyed by the read callback
+            if ((events[i].events & EPOLLOUT) && !IsRemoved(lane, socket))
+            {
+                socket->wantWrite_ = false;
+                socket->OnWritable();
+            }
+        }
+
+        ProcessReadRequests(lane);
+        RefillKeystreams(lane);
+        lane->removed.clear();
+    }
+}
+
+#else
+
+void SocketReactor::Run(Lane* lane)
+{
+    std::vector<pollfd> descriptors;
+    std::vector<AsyncSocket*> sockets;
+
+    while (running_)
+    {
+        descriptors.clear();
+        sockets.clear();
+
+        {
+            std::lock_guard<std::recursive_mutex> lock(lane->mutex);
+
+            for (AsyncSocket* socket : lane->members)
+            {
+                pollfd descriptor;
+                descriptor.fd = socket->GetHandle();
+                descriptor.events = POLLIN | (socket->wantWrite_ ? POLLOUT : 0);
+                descriptor.revents = 0;
+
+                descriptors.push_back(descriptor);
+                sockets.push_back(socket);
+            }
+
+            lane->removed.clear();
+        }
+
+        // Without a portable wake-up descriptor new requests are noticed on the next timeout
+        int32 count = 0;
+
+        if (descriptors.empty())
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        else
+            count = poll(&descriptors[0], descriptors.size(), 5);
+
+        std::lock_guard<std::recursive_mutex> lock(lane->mutex);
+
+        for (size_t i = 0; count > 0 && i < descriptors.size(); ++i)
+        {
+            AsyncSocket* socket = sockets[i];
+
+            if (IsRemoved(lane, socket))
+                continue;
+
+            if (descriptors[i].revents)
+                lane->serviced.push_back(socket);
+
+            if (descriptors[i].revents & (POLLIN | POLLHUP | POLLERR))
+                socket->OnReadable();
+
+            if ((descriptors[i].revents & POLLOUT) && !IsRemoved(lane, socket))
+            {
+                socket->wantWrite_ = false;
+                socket->OnWritable();
+            }
+        }
+
+        ProcessReadRequests(lane);
+        RefillKeystreams(lane);
+    }
+}
+
+#endif
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Define.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class AsyncSocket;
+
+// Drives every AsyncSocket of the process from a small, fixed number of I/O threads.
+// Each socket is bound to one lane (an epoll instance and the thread polling it) for
+// its whole lifetime, so its callbacks never run concurrently.
+class SocketReactor
+{
+    friend class AsyncSocket;
+
+    public:
+        const static uint32 MAX_THREADS = 4;
+
+        static SocketReactor* instance();
+
+        // Optional: the reactor starts itself with a default lane count on first use. The
+        // lanes are kept across Stop and Start, so only the first Start sets their count.
+        // While stopped, sockets fail to attach.
+        void Start(uint32 threadCount = 0);
+        void Stop();
+
+    private:
+        SocketReactor();
+        ~SocketReactor();
+
+        struct Lane;
+
+        void CreateLanes(uint32 count);
+
+        bool Add(AsyncSocket* socket);
+        void Remove(AsyncSocket* socket);
+        void RequestWrite(AsyncSocket* socket);
+        void RequestRead(AsyncSocket* socket);
+
+        void Run(Lane* lane);
+        static void ProcessReadRequests(Lane* lane);
+        static void RefillKeystreams(Lane* lane);
+        static bool IsRemoved(Lane* lane, AsyncSocket* socket);
+
+        std::mutex startMutex_;
+        std::atomic<bool> running_;
+        std::atomic<bool> stopped_;                  // Stop was called, Add no longer starts the reactor
+        std::unique_ptr<Lane> lanes_[MAX_THREADS];   // Never freed before the reactor, see Start
+        std::atomic<uint32> laneCount_;
+};
@@ -16,22 +16,64 @@
  */
 
 #include "TCPSocket.h"
+#include "Resolver.h"
+#include <chrono>
 
 #ifdef _WIN32
     #include <WS2tcpip.h>
+
+    #define poll WSAPoll
+    typedef WSAPOLLFD pollfd;
 #else
     #include <sys/types.h>
     #include <sys/socket.h>
+    #include <sys/uio.h>
     #include <netinet/in.h>
     #include <netdb.h>
     #include <unistd.h>
+    #include <fcntl.h>
+    #include <errno.h>
+    #include <poll.h>
 
     #define SD_BOTH SHUT_RDWR
     #define INVALID_SOCKET (SOCKET)(~0)
     #define SOCKET_ERROR (-1)
 #endif
 
-TCPSocket::TCPSocket() : socket_(INVALID_SOCKET)
+static bool WouldBlock()
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+// A signal arrived before any data moved, the call is simply repeated
+static bool Interrupted()
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEINTR;
+#else
+    return errno == EINTR;
+#endif
+}
+
+using namespace std::chrono;
+
+// Head start of each connection attempt before the next address is tried (RFC 8305)
+static const uint32 ConnectionAttemptDelay = 250;
+
+static bool ConnectInProgress()
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EINPROGRESS || errno == EINTR;
+#endif
+}
+
+TCPSocket::TCPSocket() : socket_(INVALID_SOCKET), resolveTimeout_(DEFAULT_RESOLVE_TIMEOUT), connectTimeout_(DEFAULT_CONNECT_TIMEOUT)
 {
 #ifdef _WIN32
     WSADATA data;
@@ -46,62 +88,240 @@ TCPSocket::~TCPSocket()
 #endif
 }
 
+bool TCPSocket::SplitAddress(std::string const& address, std::string& host, std::string& port)
+{
+    host = address;
+    port = "3724";
+
+    // [v6]:port, the brackets keep the colons of the literal apart from the port
+    if (!address.empty() && address[0] == '[')
+    {
+        size_t end = address.find(']');
+
+        if (end == std::string::npos)
+            return false;
+
+        host = address.substr(1, end - 1);
+
+        if (end + 1 == address.length())
+            return !host.empty();
+
+        if (address[end + 1] != ':' || end + 2 == address.length())
+            return false;
+
+        port = address.substr(end + 2);
+        return !host.empty();
+    }
+
+    size_t pos = address.rfind(':');
+
+    if (pos == std::string::npos)
+        return !host.empty();
+
+    // More than one colon without brackets is a bare IPv6 literal, it has no port
+    if (address.find(':') != pos)
+        return true;
+
+    host = address.substr(0, pos);
+    port = address.substr(pos + 1);
+    return !host.empty() && !port.empty();
+}
+
+AddressList TCPSocket::InterleaveFamilies(AddressList const& addresses)
+{
+    AddressList interleaved;
+    AddressList preferred, other;
+
+    for (SocketAddress const& address : addresses)
+        (address.GetFamily() == addresses[0].GetFamily() ? preferred : other).push_back(address);
+
+    for (size_t i = 0; i < preferred.size() || i < other.size(); ++i)
+    {
+        if (i < preferred.size())
+            interleaved.push_back(preferred[i]);
+
+        if (i < other.size())
+            interleaved.push_back(other[i]);
+    }
+
+    return interleaved;
+}
+
 bool TCPSocket::Connect(std::string address)
 {
-    size_t pos = address.find(':');
-    
-    std::string host = address.substr(0, pos);
-    std::string port = "3724";
- 
-    if (pos != std::string::npos)
-        port = address.substr(pos+1);
+    std::string host, port;
 
-    struct addrinfo hints;
-	memset(&hints, 0, sizeof(hints));
-	hints.ai_family = AF_INET;
-	hints.ai_socktype = SOCK_STREAM;
+    if (!SplitAddress(address, host, port))
+        return false;
 
-    struct addrinfo* serverinfo = nullptr; 
+    AddressList resolved;
 
-    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &serverinfo))
+    if (!Resolver::instance()->Resolve(host, port, resolveTimeout_, resolved))
         return false;
 
-    struct addrinfo* tmp = nullptr;
+    AddressList candidates = InterleaveFamilies(resolved);
+    std::vector<pollfd> attempts;
+    SOCKET connected = INVALID_SOCKET;
+    size_t next = 0;
 
-	for (tmp = serverinfo; tmp != nullptr; tmp = tmp->ai_next)
-	{
-		socket_ = socket(tmp->ai_family, tmp->ai_socktype, tmp->ai_protocol);
+    steady_clock::time_point now = steady_clock::now();
+    steady_clock::time_point deadline = now + milliseconds(connectTimeout_);
+    steady_clock::time_point nextAttempt = now;
 
-		if (socket_ == INVALID_SOCKET)
+    while (connected == INVALID_SOCKET && now < deadline)
+    {
+        // Start the next attempt if the previous ones had their head start or failed
+        if (next < candidates.size() && (attempts.empty() || now >= nextAttempt))
+        {
+            SocketAddress const& candidate = candidates[next++];
+            SOCKET socket = ::socket(candidate.GetFamily(), SOCK_STREAM, IPPROTO_TCP);
+
+            if (socket == INVALID_SOCKET)
+                continue;
+
+            if (!SetBlocking(socket, false))
+            {
+                Close(socket);
+                continue;
+            }
+
+            if (connect(socket, candidate.Get(), candidate.length) != SOCKET_ERROR)
+            {
+                connected = socket;
+                break;
+            }
+
+            if (!ConnectInProgress())
+            {
+                Close(socket);
+                continue;
+            }
+
+            pollfd attempt;
+            attempt.fd = socket;
+            attempt.events = POLLOUT;
+            attempt.revents = 0;
+            attempts.push_back(attempt);
+
+            nextAttempt = now + milliseconds(ConnectionAttemptDelay);
             continue;
+        }
+
+        if (attempts.empty())
+            break;
+
+        steady_clock::time_point wakeup = next < candidates.size() ? std::min(nextAttempt, deadline) : deadline;
+        int32 wait = int32(duration_cast<milliseconds>(wakeup - now).count()) + 1;
+
+        if (poll(&attempts[0], attempts.size(), wait) > 0)
+        {
+            for (size_t i = 0; i < attempts.size();)
+            {
+                if (!attempts[i].revents)
+                {
+                    ++i;
+                    continue;
+                }
+
+                int32 result = 0;
+                socklen_t length = sizeof(result);
+
+                if (getsockopt(attempts[i].fd, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&result), &length) == 0 && result == 0)
+                {
+                    connected = attempts[i].fd;
+                    attempts.erase(attempts.begin() + i);
+                    break;
+                }
+
+                // Failed, let the next address go right away
+                Close(attempts[i].fd);
+                attempts.erase(attempts.begin() + i);
+                nextAttempt = steady_clock::now();
+            }
+        }
+
+        now = steady_clock::now();
+    }
 
-		if (connect(socket_, tmp->ai_addr, tmp->ai_addrlen) == SOCKET_ERROR)
-		{
-            Disconnect();
-			continue;
-		}
+    for (pollfd const& attempt : attempts)
+        Close(attempt.fd);
 
-		break;
-	}
+    if (connected == INVALID_SOCKET)
+        return false;
 
-	freeaddrinfo(serverinfo);
-    return socket_ != INVALID_SOCKET;
+    // Callers expect a blocking socket, AsyncSocket switches it back
+    if (!SetBlocking(connected, true))
+    {
+        Close(connected);
+        return false;
+    }
+
+    socket_ = connected;
+    return true;
+}
+
+bool TCPSocket::BeginConnect(SocketAddress const& address)
+{
+    SOCKET socket = ::socket(address.GetFamily(), SOCK_STREAM, IPPROTO_TCP);
+
+    if (socket == INVALID_SOCKET)
+        return false;
+
+    if (!SetBlocking(socket, false) || (connect(socket, address.Get(), address.length) == SOCKET_ERROR && !ConnectInProgress()))
+    {
+        Close(socket);
+        return false;
+    }
+
+    socket_ = socket;
+    return true;
+}
+
+TCPSocket::ConnectStatus TCPSocket::FinishConnect()
+{
+    if (!IsConnected())
+        return CONNECT_FAILED;
+
+    pollfd descriptor;
+    descriptor.fd = socket_;
+    descriptor.events = POLLOUT;
+    descriptor.revents = 0;
+
+    int32 count = poll(&descriptor, 1, 0);
+
+    if (!count)
+        return CONNECT_IN_PROGRESS;
+
+    int32 result = 0;
+    socklen_t length = sizeof(result);
+
+    if (count < 0 || getsockopt(socket_, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&result), &length) != 0 || result != 0)
+    {
+        Disconnect();
+        return CONNECT_FAILED;
+    }
+
+    return CONNECT_SUCCEEDED;
 }
 
 void TCPSocket::Disconnect()
 {
-    if (socket_ != INVALID_SOCKET)
+    SOCKET socket = socket_.exchange(INVALID_SOCKET);
+
+    if (socket != INVALID_SOCKET)
     {
-        shutdown(socket_, SD_BOTH);
+        shutdown(socket, SD_BOTH);
+        Close(socket);
+    }
+}
 
+void TCPSocket::Close(SOCKET socket)
+{
 #ifdef _WIN32
-        closesocket(socket_);
+    closesocket(socket);
 #else
-        close(socket_);
+    close(socket);
 #endif
-
-        socket_ = INVALID_SOCKET;
-    }
 }
 
 bool TCPSocket::IsConnected()
@@ -132,12 +352,24 @@ int32 TCPSocket::Read(char* buffer, uint32 length)
 
 int32 TCPSocket::Read(ByteBuffer* buffer, uint32 length)
 {
-    char* tmp = new char[length];
+    if (!length)
+        return 0;
 
-    int32 result = Read(tmp, length);
-    buffer->append(tmp, length);
+    // Grow the buffer and receive straight into its storage
+    size_t offset = buffer->wpos();
+    size_t rpos = buffer->rpos();
+
+    buffer->resize(offset + length);
+    buffer->rpos(rpos);
+
+    int32 result = Read(reinterpret_cast<char*>(buffer->contents() + offset), length);
+
+    if (!result)
+    {
+        buffer->resize(offset);
+        buffer->rpos(rpos);
+    }
 
-    delete[] tmp;
     return result;
 }
 
@@ -160,4 +392,143 @@ int32 TCPSocket::Send(uint8 const* buffer, uint32 length)
     assert(result == length);
 
     return result;
+}
+
+int32 TCPSocket::TryRead(uint8* buffer, uint32 length)
+{
+    int32 result;
+
+    do
+    {
+        result = recv(socket_, reinterpret_cast<char*>(buffer), length, 0);
+    } while (result == SOCKET_ERROR && Interrupted());
+
+    if (!result)
+    {
+        Disconnect();
+        return 0;
+    }
+
+    if (result == SOCKET_ERROR)
+    {
+        if (!WouldBlock())
+            Disconnect();
+
+        return 0;
+    }
+
+    return result;
+}
+
+int32 TCPSocket::TrySend(uint8 const* buffer, uint32 length)
+{
+    int32 result;
+
+    do
+    {
+#ifdef MSG_NOSIGNAL
+        result = send(socket_, reinterpret_cast<char const*>(buffer), length, MSG_NOSIGNAL);
+#else
+        result = send(socket_, reinterpret_cast<char const*>(buffer), length, 0);
+#endif
+    } while (result == SOCKET_ERROR && Interrupted());
+
+    if (result == SOCKET_ERROR)
+    {
+        if (!WouldBlock())
+            Disconnect();
+
+        return 0;
+    }
+
+    return result;
+}
+
+int32 TCPSocket::TrySend(SocketBuffer const* buffers, uint32 count)
+{
+    if (count > MAX_SEND_BUFFERS)
+        count = MAX_SEND_BUFFERS;
+
+#ifdef _WIN32
+    WSABUF vectors[MAX_SEND_BUFFERS];
+
+    for (uint32 i = 0; i < count; ++i)
+    {
+        vectors[i].buf = reinterpret_cast<char*>(const_cast<uint8*>(buffers[i].data));
+        vectors[i].len = buffers[i].length;
+    }
+
+    DWORD sent = 0;
+    int32 result;
+
+    do
+    {
+        result = WSASend(socket_, vectors, count, &sent, 0, nullptr, nullptr);
+    } while (result == SOCKET_ERROR && Interrupted());
+
+    if (result == SOCKET_ERROR)
+    {
+        if (!WouldBlock())
+            Disconnect();
+
+        return 0;
+    }
+
+    return int32(sent);
+#else
+    iovec vectors[MAX_SEND_BUFFERS];
+
+    for (uint32 i = 0; i < count; ++i)
+    {
+        vectors[i].iov_base = const_cast<uint8*>(buffers[i].data);
+        vectors[i].iov_len = buffers[i].length;
+    }
+
+    msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = vectors;
+    message.msg_iovlen = count;
+
+    int32 result;
+
+    do
+    {
+#ifdef MSG_NOSIGNAL
+        result = sendmsg(socket_, &message, MSG_NOSIGNAL);
+#else
+        result = sendmsg(socket_, &message, 0);
+#endif
+    } while (result == SOCKET_ERROR && Interrupted());
+
+    if (result == SOCKET_ERROR)
+    {
+        if (!WouldBlock())
+            Disconnect();
+
+        return 0;
+    }
+
+    return result;
+#endif
+}
+
+bool TCPSocket::SetBlocking(bool blocking)
+{
+    return SetBlocking(socket_, blocking);
+}
+
+bool TCPSocket::SetBlocking(SOCKET socket, bool blocking)
+{
+#ifdef _WIN32
+    u_long mode = blocking ? 0 : 1;
+    return ioctlsocket(socket, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(socket, F_GETFL, 0);
+
+    if (flags < 0)
+        return false;
+
+    flags = blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK);
+    return fcntl(socket, F_SETFL, flags) == 0;
+#endif
 }
\ No newline at end of file
@@ -19,6 +19,8 @@
 
 #include "Define.h"
 #include "ByteBuffer.h"
+#include "Resolver.h"
+#include <atomic>
 
 #ifdef _WIN32
     #include <WinSock2.h>
@@ -26,12 +28,22 @@
     typedef unsigned int SOCKET;
 #endif
 
+// One element of a scatter/gather send
+struct SocketBuffer
+{
+    uint8 const* data;
+    uint32 length;
+};
+
 class TCPSocket
 {
     public:
         TCPSocket();
         ~TCPSocket();
 
+        // Resolves the host and races non-blocking connects to its addresses,
+        // IPv6 and IPv4 interleaved (happy eyeballs). The socket ends up blocking.
+        // The address is host, host:port, an IPv6 literal or [IPv6]:port.
         virtual bool Connect(std::string address);
         virtual void Disconnect();
         bool IsConnected();
@@ -40,6 +52,49 @@ class TCPSocket
         int32 Read(ByteBuffer* buffer, uint32 length);
         int32 Send(uint8 const* buffer, uint32 length);
 
+        // Non-blocking variants: return the number of bytes transferred, 0 if the
+        // operation would block. On error the socket is disconnected and 0 is returned.
+        int32 TryRead(uint8* buffer, uint32 length);
+        int32 TrySend(uint8 const* buffer, uint32 length);
+
+        // Gathers up to MAX_SEND_BUFFERS buffers into a single send, extra buffers are ignored
+        int32 TrySend(SocketBuffer const* buffers, uint32 count);
+
+        bool SetBlocking(bool blocking);
+        SOCKET GetHandle() const { return socket_; }
+
+        // Milliseconds, the connect timeout covers every attempt together
+        void SetResolveTimeout(uint32 timeout) { resolveTimeout_ = timeout; }
+        void SetConnectTimeout(uint32 timeout) { connectTimeout_ = timeout; }
+
+        const static uint32 MAX_SEND_BUFFERS = 64;
+        const static uint32 DEFAULT_RESOLVE_TIMEOUT = 5000;
+        const static uint32 DEFAULT_CONNECT_TIMEOUT = 10000;
+
+    protected:
+        enum ConnectStatus
+        {
+            CONNECT_IN_PROGRESS,
+            CONNECT_SUCCEEDED,
+            CONNECT_FAILED                  // The socket is disconnected
+        };
+
+        // Port defaults to 3724, false if the address is malformed
+        static bool SplitAddress(std::string const& address, std::string& host, std::string& port);
+
+        // Alternates between the families, starting with the one the resolver preferred
+        static AddressList InterleaveFamilies(AddressList const& addresses);
+
+        // Starts a non-blocking connect to one address, the socket stays non-blocking.
+        // FinishConnect checks the outcome once the socket turns writable, without waiting.
+        bool BeginConnect(SocketAddress const& address);
+        ConnectStatus FinishConnect();
+
     private:
-        SOCKET socket_;
-};
\ No newline at end of file
+        static bool SetBlocking(SOCKET socket, bool blocking);
+        static void Close(SOCKET socket);
+
+        std::atomic<SOCKET> socket_;
+        uint32 resolveTimeout_;
+        uint32 connectTimeout_;
+};
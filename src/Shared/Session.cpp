@@ -62,23 +62,28 @@ bool Session::LoadSavedData()
     if (!file)
         return false;
 
-    if (!std::getline(file, authServerAddress_))
+    return LoadData(file);
+}
+
+bool Session::LoadData(std::istream& input)
+{
+    if (!std::getline(input, authServerAddress_))
         return false;
 
-    if (!std::getline(file, accountName_))
+    if (!std::getline(input, accountName_))
         return false;
 
     std::transform(accountName_.begin(), accountName_.end(), accountName_.begin(), toupper);
 
-    if (!std::getline(file, accountPassword_))
+    if (!std::getline(input, accountPassword_))
         return false;
 
     std::transform(accountPassword_.begin(), accountPassword_.end(), accountPassword_.begin(), toupper);
 
-    if (!std::getline(file, realmName_))
+    if (!std::getline(input, realmName_))
         return false;
 
-    if (!std::getline(file, characterName_))
+    if (!std::getline(input, characterName_))
         return false;
 
     return true;
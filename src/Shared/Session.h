@@ -21,12 +21,14 @@
 #include "Define.h"
 #include "Cryptography/BigNumber.h"
 #include "Auth/RealmList.h"
+#include <istream>
 
 class Session
 {
     public:
         void RequestData();
         bool LoadSavedData();
+        bool LoadData(std::istream& input);     // The lines of settings.ini
         bool SaveData();
         void Print();
 
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstring>
+#include <ostream>
+#include <string>
+
+// Non-owning view of a character range, a small stand-in for C++17 std::string_view.
+// A view read from a ByteBuffer points into the buffer's storage, so it is only valid
+// until that buffer is modified or destroyed.
+class StringView
+{
+    public:
+        static const size_t npos = size_t(-1);
+
+        StringView() : data_(nullptr), size_(0) { }
+        StringView(char const* data, size_t size) : data_(data), size_(size) { }
+        StringView(char const* str) : data_(str), size_(std::strlen(str)) { }
+        StringView(std::string const& str) : data_(str.data()), size_(str.size()) { }
+
+        char const* data() const { return data_; }
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+
+        char const* begin() const { return data_; }
+        char const* end() const { return data_ + size_; }
+
+        char operator[](size_t pos) const { return data_[pos]; }
+
+        size_t find(char c, size_t pos = 0) const
+        {
+            if (pos >= size_)
+                return npos;
+
+            void const* found = std::memchr(data_ + pos, c, size_ - pos);
+            return found ? size_t((char const*)found - data_) : npos;
+        }
+
+        std::string ToString() const { return std::string(data_, size_); }
+
+        bool operator==(StringView const& other) const
+        {
+            return size_ == other.size_ && (size_ == 0 || std::memcmp(data_, other.data_, size_) == 0);
+        }
+
+        bool operator!=(StringView const& other) const { return !(*this == other); }
+
+    private:
+        char const* data_;
+        size_t size_;
+};
+
+inline std::ostream& operator<<(std::ostream& stream, StringView const& view)
+{
+    return stream.write(view.data(), view.size());
+}
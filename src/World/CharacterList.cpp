@@ -16,56 +16,23 @@
  */
 
 #include "CharacterList.h"
+#include "WorldPacketSchemas.h"
 
-void CharacterList::Populate(uint8 count, WorldPacket &recvPacket)
+bool CharacterList::Populate(uint8 count, WorldPacket &recvPacket)
 {
     list_.clear();
     list_.resize(count);
 
     for (uint8 i = 0; i < count; i++)
     {
-        Character character;
-
-        recvPacket >> character.Guid;
-        recvPacket >> character.Name;
-        recvPacket.read((uint8*)&character.Race, 1);
-        recvPacket.read((uint8*)&character.Class, 1);
-        recvPacket.read((uint8*)&character.Gender, 1);
-        recvPacket >> character.Display.Skin;
-        recvPacket >> character.Display.Face;
-        recvPacket >> character.Display.HairStyle;
-        recvPacket >> character.Display.HairColor;
-        recvPacket >> character.Display.FacialHair;
-        recvPacket >> character.Level;
-        recvPacket >> character.AreaId;
-        recvPacket >> character.MapId;
-        recvPacket >> character.Position.X;
-        recvPacket >> character.Position.Y;
-        recvPacket >> character.Position.Z;
-        recvPacket >> character.GuildId;
-        recvPacket >> character.Flags;
-        recvPacket >> character.CustomizationFlags;
-        recvPacket >> character.IsFirstLogin;
-        recvPacket >> character.Pet.DisplayId;
-        recvPacket >> character.Pet.Level;
-        recvPacket >> character.Pet.Family;
-
-        for (uint8 j = 0; j < 19; j++)
+        if (!CharacterSchema::Read(recvPacket, list_[i]))
         {
-            recvPacket >> character.Items[j].DisplayId;
-            recvPacket >> character.Items[j].InventoryType;
-            recvPacket >> character.Items[j].EnchantAuraId;
+            list_.resize(i);
+            return false;
         }
-
-        for (uint8 j = 0; j < 4; j++)
-        {
-            recvPacket >> character.Bags[j].DisplayId;
-            recvPacket >> character.Bags[j].InventoryType;
-            recvPacket >> character.Bags[j].EnchantId;
-        }
-
-        list_[i] = character;
     }
+
+    return true;
 }
 
 void CharacterList::Print() const
@@ -25,7 +25,7 @@
 class CharacterList
 {
     public:
-        void Populate(uint8 count, WorldPacket &recvPacket);
+        bool Populate(uint8 count, WorldPacket &recvPacket);
         void Print() const;
  
         Character const* GetCharacterByName(std::string name) const;
@@ -18,9 +18,10 @@
 #include "EventMgr.h"
 #include "Common.h"
 #include <algorithm>
+#include <limits>
 using namespace std::chrono;
 
-Event::Event(EventId id) : id_(id), enabled_(false), period_(0), remaining_(0)
+Event::Event(EventId id) : id_(id), enabled_(false), restarted_(false), manager_(nullptr), period_(0), remaining_(0)
 {
 
 }
@@ -43,47 +44,80 @@ void Event::SetCallback(EventCallback callback)
 
 void Event::SetEnabled(bool enabled)
 {
-    enabled_ = enabled;
+    if (enabled_.exchange(enabled) || !enabled)
+        return;
+
+    restarted_ = true;
+
+    if (EventMgr* manager = manager_)
+        manager->Reschedule();
 }
 
-void Event::Update(uint32 diff)
+void Event::Update(uint32 diff, bool triggered)
 {
     if (!enabled_)
         return;
 
-    if (remaining_ <= 0)
+    // The time spent disabled doesn't count
+    if (restarted_.exchange(false))
     {
-        callback_();
         remaining_ = period_;
+        diff = 0;
     }
-    else
+
+    if (period_)
+    {
         remaining_ -= diff;
+
+        if (remaining_ <= 0)
+        {
+            triggered = true;
+            remaining_ = period_;
+        }
+    }
+
+    if (triggered)
+        callback_();
 }
 
-EventMgr::EventMgr() : isRunning_(false)
+uint32 Event::GetRemaining()
 {
+    if (!enabled_ || !period_)
+        return std::numeric_limits<uint32>::max();
 
+    return remaining_ > 0 ? uint32(remaining_) : 0;
 }
 
-EventMgr::~EventMgr()
+EventMgr::EventMgr() : isRunning_(false), triggered_(0), rescheduled_(false)
 {
-    isRunning_ = false;
 
-    if (thread_.joinable())
-        thread_.join();
+}
+
+EventMgr::~EventMgr()
+{
+    Stop();
 }
 
 void EventMgr::AddEvent(std::shared_ptr<Event> event)
 {
-    std::lock_guard<std::recursive_mutex> lock(eventMutex_);
-    events_.push_back(event);
+    {
+        std::lock_guard<std::recursive_mutex> lock(eventMutex_);
+        event->manager_ = this;
+        events_.push_back(event);
+    }
+
+    Reschedule();
 }
 
 void EventMgr::RemoveEvent(EventId id)
 {
     std::lock_guard<std::recursive_mutex> lock(eventMutex_);
     events_.remove_if([id](std::shared_ptr<Event> const& event) {
-        return event->GetId() == id;
+        if (event->GetId() != id)
+            return false;
+
+        event->manager_ = nullptr;
+        return true;
     });
 }
 
@@ -100,6 +134,34 @@ std::shared_ptr<Event> EventMgr::GetEvent(EventId id)
     return *itr;
 }
 
+void EventMgr::TriggerEvent(EventId id)
+{
+    uint32 mask = 1 << id;
+
+    // Already pending, the event thread has been woken up for it
+    if (triggered_.fetch_or(mask) & mask)
+        return;
+
+    Wake();
+}
+
+void EventMgr::Reschedule()
+{
+    // The event thread may be sleeping past the next period of the new event
+    if (!rescheduled_.exchange(true))
+        Wake();
+}
+
+void EventMgr::Wake()
+{
+    // Taking the lock orders us against the predicate check in ProcessEvents
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+    }
+
+    wakeCondition_.notify_one();
+}
+
 void EventMgr::Start()
 {
     assert(!isRunning_);
@@ -111,6 +173,7 @@ void EventMgr::Start()
 void EventMgr::Stop()
 {
     isRunning_ = false;
+    Wake();
 
     if (thread_.joinable())
         thread_.join();
@@ -118,22 +181,47 @@ void EventMgr::Stop()
 
 void EventMgr::ProcessEvents()
 {
-    uint32 diff = 0;
+    steady_clock::time_point last = steady_clock::now();
 
     while (isRunning_)
     {
-        system_clock::time_point start = high_resolution_clock::now();
+        steady_clock::time_point now = steady_clock::now();
+        uint32 diff = uint32(duration_cast<milliseconds>(now - last).count());
+        last += milliseconds(diff);
+
+        uint32 triggered = triggered_.exchange(0);
+        rescheduled_ = false;
+        uint32 wait = std::numeric_limits<uint32>::max();
+
+        // Callbacks may take other locks, e.g. the session lock, while a packet
+        // handler holding those calls GetEvent, so they run without eventMutex_
+        {
+            std::lock_guard<std::recursive_mutex> lock(eventMutex_);
+            snapshot_.assign(events_.begin(), events_.end());
+        }
+
+        for (std::shared_ptr<Event> const& event : snapshot_)
+            event->Update(diff, (triggered & (1 << event->GetId())) != 0);
+
+        for (std::shared_ptr<Event> const& event : snapshot_)
+            wait = std::min(wait, event->GetRemaining());
+
+        // Sleep until the next periodic event is due or something is triggered
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        auto woken = [this]() { return triggered_ != 0 || rescheduled_ || !isRunning_; };
+
+        if (wait == std::numeric_limits<uint32>::max())
+            wakeCondition_.wait(lock, woken);
+        else
+            wakeCondition_.wait_for(lock, milliseconds(wait), woken);
+    }
 
-        std::lock_guard<std::recursive_mutex> lock(eventMutex_);
+    snapshot_.clear();
 
-        for (std::shared_ptr<Event> event : events_)
-            event->Update(diff);
+    std::lock_guard<std::recursive_mutex> lock(eventMutex_);
 
-        std::this_thread::sleep_for(milliseconds(5));
-        system_clock::time_point end = high_resolution_clock::now();
-        diff = uint32(duration_cast<milliseconds>(end - start).count());
-    }
+    for (std::shared_ptr<Event> const& event : events_)
+        event->manager_ = nullptr;
 
-    std::lock_guard<std::recursive_mutex> lock(eventMutex_);
     events_.clear();
-}
\ No newline at end of file
+}
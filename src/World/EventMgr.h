@@ -19,11 +19,15 @@
 
 #include "Define.h"
 #include <list>
+#include <vector>
 #include <functional>
 #include <thread>
 #include <memory>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
 
+// Ids are also bit positions in the trigger mask, keep them below 32
 enum EventId
 {
     EVENT_PROCESS_INCOMING      = 0,
@@ -34,21 +38,31 @@ enum EventId
 
 typedef std::function<void()> EventCallback;
 
+class EventMgr;
+
 class Event
 {
+    friend class EventMgr;
+
     public:
         Event(EventId id);
 
         EventId GetId();
 
+        // An event without a period only runs when it is triggered
         void SetPeriod(uint32 period);
+
+        // Enabling an event starts its period over and wakes the event thread to count it
         void SetEnabled(bool enabled);
         void SetCallback(EventCallback callback);
 
-        void Update(uint32 diff);
+        void Update(uint32 diff, bool triggered);
+        uint32 GetRemaining();
     private:
         EventId id_;
-        bool enabled_;
+        std::atomic<bool> enabled_;                     // May be toggled from packet handlers on another thread
+        std::atomic<bool> restarted_;                   // Enabled since the last update, the period starts over
+        std::atomic<EventMgr*> manager_;                // Set once the event is added
         uint32 period_;
         int32 remaining_;
         EventCallback callback_;
@@ -56,6 +70,8 @@ class Event
 
 class EventMgr
 {
+    friend class Event;
+
     public:
         EventMgr();
         ~EventMgr();
@@ -64,14 +80,26 @@ class EventMgr
         void RemoveEvent(EventId id);
         std::shared_ptr<Event> GetEvent(EventId id);
 
+        // Runs the event as soon as possible, can be called from any thread
+        void TriggerEvent(EventId id);
+
         void Start();
         void Stop();
 
     private:
         std::thread thread_;
-        bool isRunning_;
+        std::atomic<bool> isRunning_;
         std::recursive_mutex eventMutex_;
         std::list<std::shared_ptr<Event>> events_;
+        std::vector<std::shared_ptr<Event>> snapshot_;  // Events being updated, callbacks run without eventMutex_
+
+        std::mutex wakeMutex_;
+        std::condition_variable wakeCondition_;
+        std::atomic<uint32> triggered_;                 // Mask of triggered event ids
+        std::atomic<bool> rescheduled_;                 // An event was enabled or added, the sleep time is stale
+
+        void Reschedule();
+        void Wake();
 
         void ProcessEvents();
 };
@@ -19,20 +19,18 @@
 #include "Cryptography/SHA1.h"
 #include "Config.h"
 #include "Addon.h"
+#include "WorldPacketSchemas.h"
 #include <zlib/zlib.h>
 
 void WorldSession::HandleAuthenticationChallenge(WorldPacket &recvPacket)
 {
-    uint32 unk;
-    uint32 serverSeed;
+    AuthChallenge challenge;
 
-    recvPacket >> unk;
-    recvPacket >> serverSeed;
-
-    uint8 encryptionSeed[2][16];
-
-    recvPacket.read(encryptionSeed[0], 16);
-    recvPacket.read(encryptionSeed[1], 16);
+    if (!AuthChallengeSchema::Read(recvPacket, challenge))
+    {
+        error("Malformed authentication challenge (size: %u)", uint32(recvPacket.size()));
+        return;
+    }
 
     uint32 zero = 0;
     uint32 clientSeed = 0x4B8C87D0;
@@ -41,21 +39,19 @@ void WorldSession::HandleAuthenticationChallenge(WorldPacket &recvPacket)
     authResponse.Update(session_->GetAccountName());
     authResponse.Update((uint8*)&zero, sizeof(uint32));
     authResponse.Update((uint8*)&clientSeed, sizeof(uint32));
-    authResponse.Update((uint8*)&serverSeed, sizeof(uint32));
+    authResponse.Update((uint8*)&challenge.ServerSeed, sizeof(uint32));
     authResponse.Update(session_->GetKey());
     authResponse.Finalize();
 
+    AuthSessionHeader header;
+    header.Build = GameBuild;
+    header.Account = session_->GetAccountName();
+    header.ClientSeed = clientSeed;
+    header.RealmId = session_->GetRealm().ID;
+    memcpy(header.Digest, authResponse.GetDigest(), sizeof(header.Digest));
+
     WorldPacket response(CMSG_AUTH_SESSION);
-    response << uint32(GameBuild);
-    response << uint32(0);
-    response << session_->GetAccountName();
-    response << uint32(0);
-    response << clientSeed;
-    response << uint32(0);
-    response << uint32(0);
-    response << uint32(session_->GetRealm().ID);
-    response << uint64(0);
-    response.append(authResponse.GetDigest(), 20);
+    AuthSessionHeaderSchema::Write(response, header);
 
     ByteBuffer addonData;
     addonData << uint32(AddonDatabase.size());
@@ -82,7 +78,7 @@ void WorldSession::HandleAuthenticationChallenge(WorldPacket &recvPacket)
     response << uint32(addonData.size());
     response.append(addonDataCompressed.contents(), compressedSize);
 
-    SendPacket(response);
+    SendPacket(std::move(response));
 }
 
 enum AuthResult : uint8
@@ -139,5 +135,5 @@ void WorldSession::HandleAuthenticationResponse(WorldPacket &recvPacket)
     print("%s", "Successfully authenticated!");
 
     WorldPacket packet(CMSG_CHAR_ENUM, 0);
-    SendPacket(packet);
+    SendPacket(std::move(packet));
 }
\ No newline at end of file
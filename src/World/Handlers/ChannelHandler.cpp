@@ -29,7 +29,7 @@ void WorldSession::JoinChannel(const std::string name, const std::string passwor
     packet.FlushBits();
     packet.WriteString(name);
     packet.WriteString(password);
-    SendPacket(packet);
+    SendPacket(std::move(packet));
 }
 
 enum ChatNotify : uint8_t
@@ -78,8 +78,7 @@ void WorldSession::HandleChannelNotification(WorldPacket &recvPacket)
 {
     ChatNotify type = recvPacket.read<ChatNotify>();
 
-    std::string channelName;
-    recvPacket >> channelName;
+    StringView channelName = recvPacket.ReadCString();
 
     switch (type)
     {
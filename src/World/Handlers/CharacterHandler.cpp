@@ -31,7 +31,12 @@ void WorldSession::HandleCharacterEnum(WorldPacket &recvPacket)
     }
 
     CharacterList characterlist;
-    characterlist.Populate(count, recvPacket);
+    if (!characterlist.Populate(count, recvPacket))
+    {
+        error("Malformed character list (size: %u), ignored", uint32(recvPacket.size()));
+        return;
+    }
+
     characterlist.Print();
 
     if (Character const* character = characterlist.GetCharacterByName(session_->GetCharacterName()))
@@ -41,7 +46,7 @@ void WorldSession::HandleCharacterEnum(WorldPacket &recvPacket)
 
         WorldPacket packet(CMSG_PLAYER_LOGIN);
         packet << player_.Guid;
-        SendPacket(packet);
+        SendPacket(std::move(packet));
 
         if (std::shared_ptr<Event> pingEvent = eventMgr_.GetEvent(EVENT_SEND_PING))
             pingEvent->SetEnabled(true);
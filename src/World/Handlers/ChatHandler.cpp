@@ -17,14 +17,17 @@
 
 #include <iostream>
 #include "WorldSession.h"
+#include "WorldPacketSchemas.h"
 
 void WorldSession::HandleMessageChat(WorldPacket &recvPacket)
 {
     ChatMessage message;
-    message.Type = recvPacket.read<ChatType>();
-    message.Language = recvPacket.read<Languages>();
-    recvPacket >> message.SenderGUID;
-    recvPacket >> message.Flags;
+
+    if (!ChatMessageHeaderSchema::Read(recvPacket, message))
+    {
+        error("Malformed chat message (opcode 0x%04x), ignored", recvPacket.GetOpcode());
+        return;
+    }
 
     switch (message.Type)
     {
@@ -37,29 +40,29 @@ void WorldSession::HandleMessageChat(WorldPacket &recvPacket)
         case CHAT_MSG_RAID_BOSS_WHISPER:
         case CHAT_MSG_BATTLENET:
         {
-            recvPacket.read_skip<uint32_t>();
-            recvPacket >> message.SenderName;
-            recvPacket >> message.ReceiverGUID;
+            recvPacket.TryReadSkip<uint32_t>();
+            recvPacket.TryRead(message.SenderName);
+            recvPacket.TryRead(message.ReceiverGUID);
 
             if (!message.ReceiverGUID.IsEmpty() && !message.ReceiverGUID.IsPlayer() && !message.ReceiverGUID.IsPet())
             {
-                recvPacket.read_skip<uint32_t>();
-                recvPacket >> message.ReceiverName;
+                recvPacket.TryReadSkip<uint32_t>();
+                recvPacket.TryRead(message.ReceiverName);
             }
 
             if (message.Language == LANG_ADDON)
-                recvPacket >> message.AddonPrefix;
+                recvPacket.TryRead(message.AddonPrefix);
 
             break;
         }
         case CHAT_MSG_WHISPER_FOREIGN:
         {
-            recvPacket.read_skip<uint32_t>();
-            recvPacket >> message.SenderName;
-            recvPacket >> message.ReceiverGUID;
+            recvPacket.TryReadSkip<uint32_t>();
+            recvPacket.TryRead(message.SenderName);
+            recvPacket.TryRead(message.ReceiverGUID);
 
             if (message.Language == LANG_ADDON)
-                recvPacket >> message.AddonPrefix;
+                recvPacket.TryRead(message.AddonPrefix);
 
             break;
         }
@@ -67,26 +70,26 @@ void WorldSession::HandleMessageChat(WorldPacket &recvPacket)
         case CHAT_MSG_BG_SYSTEM_ALLIANCE:
         case CHAT_MSG_BG_SYSTEM_HORDE:
         {
-            recvPacket >> message.ReceiverGUID;
+            recvPacket.TryRead(message.ReceiverGUID);
 
             if (!message.ReceiverGUID.IsEmpty() && !message.ReceiverGUID.IsPlayer())
             {
-                recvPacket.read_skip<uint32_t>();
-                recvPacket >> message.ReceiverName;
+                recvPacket.TryReadSkip<uint32_t>();
+                recvPacket.TryRead(message.ReceiverName);
             }
 
             if (message.Language == LANG_ADDON)
-                recvPacket >> message.AddonPrefix;
+                recvPacket.TryRead(message.AddonPrefix);
 
             break;
         }
         case CHAT_MSG_ACHIEVEMENT:
         case CHAT_MSG_GUILD_ACHIEVEMENT:
         {
-            recvPacket >> message.ReceiverGUID;
+            recvPacket.TryRead(message.ReceiverGUID);
 
             if (message.Language == LANG_ADDON)
-                recvPacket >> message.AddonPrefix;
+                recvPacket.TryRead(message.AddonPrefix);
  
             break;
         }
@@ -94,39 +97,47 @@ void WorldSession::HandleMessageChat(WorldPacket &recvPacket)
         {
             if (recvPacket.GetOpcode() == SMSG_GM_MESSAGECHAT)
             {
-                recvPacket.read_skip<uint32_t>();
-                recvPacket >> message.SenderName;
+                recvPacket.TryReadSkip<uint32_t>();
+                recvPacket.TryRead(message.SenderName);
             }
 
             if (message.Type == CHAT_MSG_CHANNEL)
-                recvPacket >> message.ChannelName;
+                recvPacket.TryRead(message.ChannelName);
 
-            recvPacket >> message.ReceiverGUID;
+            recvPacket.TryRead(message.ReceiverGUID);
 
             if (message.Language == LANG_ADDON)
-                recvPacket >> message.AddonPrefix;
+                recvPacket.TryRead(message.AddonPrefix);
 
             break;
         }
     }
 
-    recvPacket.read_skip<uint32_t>();
-    recvPacket >> message.Message;
+    // Addon messages are dropped below, so the text is only copied out once it is needed
+    StringView text;
+    recvPacket.TryReadSkip<uint32_t>();
+    recvPacket.TryRead(text);
 
-    ChatTag tag = recvPacket.read<ChatTag>();
+    recvPacket.TryRead(message.Tag);
 
     if (message.Type == CHAT_MSG_ACHIEVEMENT || message.Type == CHAT_MSG_GUILD_ACHIEVEMENT)
     {
         uint32_t achievementId;
-        recvPacket >> achievementId;
+        recvPacket.TryRead(achievementId);
     }
     else if (message.Type == CHAT_MSG_RAID_BOSS_WHISPER || message.Type == CHAT_MSG_RAID_BOSS_EMOTE)
     {
         float displayTime;
         bool hideInChatFrame;
 
-        recvPacket >> displayTime;
-        recvPacket >> hideInChatFrame;
+        recvPacket.TryRead(displayTime);
+        recvPacket.TryRead(hideInChatFrame);
+    }
+
+    if (recvPacket.HasReadError())
+    {
+        error("Malformed chat message (opcode 0x%04x), ignored", recvPacket.GetOpcode());
+        return;
     }
 
     if (message.SenderGUID.IsPlayer())
@@ -144,5 +155,6 @@ void WorldSession::HandleMessageChat(WorldPacket &recvPacket)
     if (message.Language == LANG_ADDON)
         return;
 
+    message.Message = text.ToString();
     chatMgr_.EnqueueMessage(message);
 }
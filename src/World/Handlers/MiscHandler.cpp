@@ -49,7 +49,7 @@ void WorldSession::SendPing()
     WorldPacket packet(CMSG_PING);
     packet << uint32(ping_);
     packet << uint32(ping_ / 2);
-    SendPacket(packet);
+    SendPacket(std::move(packet));
 }
 
 void WorldSession::HandleTimeSyncRequest(WorldPacket &recvPacket)
@@ -63,7 +63,7 @@ void WorldSession::HandleTimeSyncRequest(WorldPacket &recvPacket)
     WorldPacket packet(CMSG_TIME_SYNC_RESP, 8);
     packet << timeSyncCounter;
     packet << uint32(ms.count());
-    SendPacket(packet);
+    SendPacket(std::move(packet));
 
     playerNames_.Save();
 }
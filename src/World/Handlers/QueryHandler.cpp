@@ -25,36 +25,43 @@ void WorldSession::SendNameQuery(ObjectGuid guid)
 
     WorldPacket packet(CMSG_NAME_QUERY);
     packet << guid;
-    SendPacket(packet);
+    SendPacket(std::move(packet));
 }
 
 void WorldSession::HandleNameQueryResponse(WorldPacket &recvPacket)
 {
     PlayerNameEntry entry;
-    recvPacket.readPackGUID(entry.GUID);
+    recvPacket.TryReadPackGUID(entry.GUID);
 
     bool isUnknown;
-    recvPacket >> isUnknown;
+    recvPacket.TryRead(isUnknown);
 
     // Every normal server..
     if (isUnknown)
         return;
 
-    std::string name;
-    recvPacket >> name;
+    StringView name;
+    recvPacket.TryRead(name);
 
     // ..and Tauri WoW Server ("<nem létezõ karakter>" if it doesn't exist)
-    if (name.find('<') != std::string::npos && name.find('>') != std::string::npos)
+    if (name.find('<') != StringView::npos && name.find('>') != StringView::npos)
         return;
 
-    std::string realmName;
-    recvPacket >> realmName;
+    StringView realmName;
+    recvPacket.TryRead(realmName);
 
-    memcpy(&entry.Name, name.c_str(), name.size() + 1);
+    recvPacket.TryRead(entry.PlayerRace);
+    recvPacket.TryRead(entry.PlayerGender);
+    recvPacket.TryRead(entry.PlayerClass);
 
-    entry.PlayerRace = recvPacket.read<Races>();
-    entry.PlayerGender = recvPacket.read<Genders>();
-    entry.PlayerClass = recvPacket.read<Classes>();
+    if (recvPacket.HasReadError() || name.size() >= sizeof(entry.Name))
+    {
+        error("Malformed name query response (size: %u), ignored", uint32(recvPacket.size()));
+        return;
+    }
+
+    memcpy(&entry.Name, name.data(), name.size());
+    entry.Name[name.size()] = '\0';
 
     // Add to cache
     if (!playerNames_.Has(entry))
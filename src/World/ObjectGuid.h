@@ -24,6 +24,7 @@
 #include <cstdint>
 #include <functional>
 #include <cassert>
+#include <cstring>
 
 enum TypeID
 {
@@ -225,4 +226,112 @@ class ObjectGuid
         } _data;
 };
 
+// Packed guid wire format: a mask byte telling which bytes of the guid are non-zero,
+// followed by those bytes from the lowest to the highest. Encode and Decode are shared
+// by ByteBuffer and ByteReader, both are branch free apart from the single bounds check.
+class PackedGuid
+{
+    public:
+        static const size_t MAX_SIZE = 1 + sizeof(uint64_t);
+
+        PackedGuid() : size_(1) { bytes_[0] = 0; }
+        explicit PackedGuid(uint64_t guid) { Set(guid); }
+
+        void Set(uint64_t guid) { size_ = uint8_t(Encode(guid, bytes_)); }
+
+        uint8_t const* contents() const { return bytes_; }
+        size_t size() const { return size_; }
+
+        // Number of bytes following the mask
+        static uint32_t GetPayloadSize(uint8_t mask)
+        {
+            static const uint8_t NibbleBits[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+            return NibbleBits[mask & 0x0F] + NibbleBits[mask >> 4];
+        }
+
+        // Writes MAX_SIZE bytes at most, returns how many were used
+        static size_t Encode(uint64_t guid, uint8_t* dest)
+        {
+            uint8_t mask = 0;
+            size_t size = 1;
+
+            // Every byte is stored, only the non-zero ones advance the output
+            for (uint32_t i = 0; i < 8; ++i)
+            {
+                uint8_t byte = uint8_t(guid >> (i * 8));
+                uint32_t used = byte != 0;
+
+                dest[size] = byte;
+                mask |= uint8_t(used << i);
+                size += used;
+            }
+
+            dest[0] = mask;
+            return size;
+        }
+
+        // Returns the number of bytes consumed, 0 if the data is truncated
+        static size_t Decode(uint8_t const* data, size_t length, uint64_t& guid)
+        {
+            guid = 0;
+
+            if (!length)
+                return 0;
+
+            uint8_t mask = data[0];
+            uint32_t count = GetPayloadSize(mask);
+
+            if (1 + count > length)
+                return 0;
+
+            // Inside a packet there are usually 8 bytes to spare, a fixed size copy is a single load.
+            // The last byte always stays zero.
+            uint8_t payload[MAX_SIZE] = { };
+            if (length >= MAX_SIZE)
+                std::memcpy(payload, data + 1, sizeof(uint64_t));
+            else
+                std::memcpy(payload, data + 1, count);
+
+            // Payload byte of every guid byte, unused ones point at the zero byte at the end
+            uint8_t const* index = GetScatterTable()[mask];
+
+            for (uint32_t i = 0; i < 8; ++i)
+                guid |= uint64_t(payload[index[i]]) << (i * 8);
+
+            return 1 + count;
+        }
+
+    private:
+        typedef uint8_t ScatterRow[8];
+
+        static ScatterRow const* GetScatterTable()
+        {
+            struct ScatterTable
+            {
+                ScatterTable()
+                {
+                    for (uint32_t mask = 0; mask < 256; ++mask)
+                    {
+                        uint8_t next = 0;
+                        for (uint32_t i = 0; i < 8; ++i)
+                            rows[mask][i] = (mask & (1 << i)) ? next++ : 8;
+                    }
+                }
+
+                ScatterRow rows[256];
+            };
+
+            static ScatterTable const table;
+            return table.rows;
+        }
+
+        uint8_t bytes_[MAX_SIZE];
+        uint8_t size_;
+};
+
+inline PackedGuid ObjectGuid::WriteAsPacked() const
+{
+    return PackedGuid(_data._guid);
+}
+
 #endif // ObjectGuid_h__
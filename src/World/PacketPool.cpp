@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PacketPool.h"
+#include "Common.h"
+#include <algorithm>
+
+static const uint32 ClassSizes[PacketPool::SIZE_CLASSES] = { 64, 256, 1024, 4096, 16384, 65536 };
+
+// Memory budgets per size class, the small classes keep more packets around
+static const uint32 ThreadCacheBytes = 256 * 1024;
+static const uint32 DepotBytes = 4 * 1024 * 1024;
+static const uint32 MaxThreadCacheSize = 64;
+
+struct PacketPool::ThreadCache
+{
+    ThreadCache()
+    {
+        for (std::vector<WorldPacket*>& packets : free)
+            packets.reserve(MaxThreadCacheSize);
+    }
+
+    ~ThreadCache()
+    {
+        // Threads may exit after the pool is gone, so the packets are not handed back
+        for (std::vector<WorldPacket*>& packets : free)
+            for (WorldPacket* packet : packets)
+                delete packet;
+    }
+
+    std::vector<WorldPacket*> free[SIZE_CLASSES];
+};
+
+void WorldPacketDeleter::operator()(WorldPacket* packet) const
+{
+    PacketPool::instance()->Release(packet);
+}
+
+PacketPool::PacketPool() : oversized_(0)
+{
+    for (uint32 i = 0; i < SIZE_CLASSES; ++i)
+    {
+        SizeClass& sizeClass = classes_[i];
+        sizeClass.cacheLimit = std::min(MaxThreadCacheSize, std::max(4u, ThreadCacheBytes / ClassSizes[i]));
+        sizeClass.depotLimit = std::max(32u, DepotBytes / ClassSizes[i]);
+        sizeClass.depot.reserve(sizeClass.depotLimit);
+    }
+}
+
+PacketPool::~PacketPool()
+{
+    for (SizeClass& sizeClass : classes_)
+        for (WorldPacket* packet : sizeClass.depot)
+            delete packet;
+}
+
+PacketPool* PacketPool::instance()
+{
+    static PacketPool pool;
+    return &pool;
+}
+
+PacketPool::ThreadCache& PacketPool::GetThreadCache()
+{
+    static thread_local ThreadCache cache;
+    return cache;
+}
+
+uint32 PacketPool::GetClassSize(uint32 sizeClass) const
+{
+    return ClassSizes[sizeClass];
+}
+
+WorldPacketPtr PacketPool::Acquire(Opcodes opcode, size_t reserve)
+{
+    uint32 index = 0;
+
+    while (index < SIZE_CLASSES && ClassSizes[index] < reserve)
+        ++index;
+
+    if (index == SIZE_CLASSES)
+    {
+        ++oversized_;
+        return WorldPacketPtr(new WorldPacket(opcode, reserve));
+    }
+
+    SizeClass& sizeClass = classes_[index];
+    std::vector<WorldPacket*>& cache = GetThreadCache().free[index];
+
+    // Take half a cache worth of packets from the depot
+    if (cache.empty())
+    {
+        std::lock_guard<std::mutex> lock(sizeClass.mutex);
+
+        size_t count = std::min<size_t>(sizeClass.depot.size(), sizeClass.cacheLimit / 2);
+        cache.insert(cache.end(), sizeClass.depot.end() - count, sizeClass.depot.end());
+        sizeClass.depot.resize(sizeClass.depot.size() - count);
+    }
+
+    if (cache.empty())
+    {
+        sizeClass.misses.fetch_add(1, std::memory_order_relaxed);
+        return WorldPacketPtr(new WorldPacket(opcode, ClassSizes[index]));
+    }
+
+    sizeClass.hits.fetch_add(1, std::memory_order_relaxed);
+
+    WorldPacket* packet = cache.back();
+    cache.pop_back();
+
+    packet->SetOpcode(opcode);
+    return WorldPacketPtr(packet);
+}
+
+void PacketPool::Release(WorldPacket* packet)
+{
+    if (!packet)
+        return;
+
+    // Storage that grew far beyond the largest class is not worth keeping
+    size_t capacity = packet->capacity();
+
+    if (capacity < ClassSizes[0] || capacity >= ClassSizes[SIZE_CLASSES - 1] * 2)
+    {
+        delete packet;
+        return;
+    }
+
+    // Largest class the storage can serve
+    uint32 index = SIZE_CLASSES - 1;
+
+    while (ClassSizes[index] > capacity)
+        --index;
+
+    packet->clear();
+    packet->ResetBitPos();
+    packet->SetChunk(0, 0);
+
+    SizeClass& sizeClass = classes_[index];
+    std::vector<WorldPacket*>& cache = GetThreadCache().free[index];
+
+    // Hand half of a full cache to the depot, so the borrowing thread can take it
+    if (cache.size() >= sizeClass.cacheLimit)
+    {
+        std::lock_guard<std::mutex> lock(sizeClass.mutex);
+
+        size_t room = sizeClass.depotLimit - std::min<size_t>(sizeClass.depot.size(), sizeClass.depotLimit);
+        size_t count = std::min<size_t>(cache.size() / 2, room);
+        sizeClass.depot.insert(sizeClass.depot.end(), cache.end() - count, cache.end());
+        cache.resize(cache.size() - count);
+    }
+
+    if (cache.size() >= sizeClass.cacheLimit)
+    {
+        delete packet;
+        return;
+    }
+
+    cache.push_back(packet);
+}
+
+void PacketPool::PrintStatistics() const
+{
+    print("%s", "Packet pool:");
+
+    for (uint32 i = 0; i < SIZE_CLASSES; ++i)
+        print(" - %5u bytes: %llu hits, %llu misses", ClassSizes[i], (unsigned long long)GetHits(i), (unsigned long long)GetMisses(i));
+
+    print(" - Oversized: %llu", (unsigned long long)oversized_.load());
+}
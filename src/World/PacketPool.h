@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Define.h"
+#include "WorldPacket.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// Recycles WorldPackets together with their storage. Packets are grouped into
+// size classes by capacity, every thread keeps a small cache of each class in
+// front of a shared depot, so borrowing and returning is usually lock-free.
+// Packets may be returned from a different thread than the one borrowing them.
+class PacketPool
+{
+    public:
+        const static uint32 SIZE_CLASSES = 6;
+
+        static PacketPool* instance();
+
+        // The packet is empty, with at least the requested capacity
+        WorldPacketPtr Acquire(Opcodes opcode, size_t reserve);
+        void Release(WorldPacket* packet);
+
+        uint32 GetClassSize(uint32 sizeClass) const;
+        uint64 GetHits(uint32 sizeClass) const { return classes_[sizeClass].hits; }
+        uint64 GetMisses(uint32 sizeClass) const { return classes_[sizeClass].misses; }
+        void PrintStatistics() const;
+
+    private:
+        PacketPool();
+        ~PacketPool();
+
+        struct SizeClass
+        {
+            SizeClass() : hits(0), misses(0) { }
+
+            std::mutex mutex;
+            std::vector<WorldPacket*> depot;
+            uint32 depotLimit;
+            uint32 cacheLimit;
+
+            std::atomic<uint64> hits;
+            std::atomic<uint64> misses;
+        };
+
+        struct ThreadCache;
+        static ThreadCache& GetThreadCache();
+
+        SizeClass classes_[SIZE_CLASSES];
+        std::atomic<uint64> oversized_;                 // Packets too large for any class, never pooled
+};
@@ -21,32 +21,60 @@
 
 #include "Network/ByteBuffer.h"
 #include "Opcodes.h"
+#include <memory>
  
 class WorldPacket : public ByteBuffer
 {
     public:
-        WorldPacket() : ByteBuffer(0), opcode_(MSG_NULL_ACTION)
+        WorldPacket() : ByteBuffer(0), opcode_(MSG_NULL_ACTION), chunkOffset_(0), streamSize_(0)
         {
         }
  
-        explicit WorldPacket(Opcodes opcode, size_t res = 200) : ByteBuffer(res), opcode_(opcode)
+        // Nothing is reserved by default, small packets fit the inline storage of ByteBuffer
+        explicit WorldPacket(Opcodes opcode, size_t res = 0) : ByteBuffer(res), opcode_(opcode), chunkOffset_(0), streamSize_(0)
         {
         }
  
-        WorldPacket(const WorldPacket &packet) : ByteBuffer(packet), opcode_(packet.opcode_)
+        WorldPacket(const WorldPacket &packet) : ByteBuffer(packet), opcode_(packet.opcode_),
+            chunkOffset_(packet.chunkOffset_), streamSize_(packet.streamSize_)
         {
         }
+
+        WorldPacket(WorldPacket &&packet) : ByteBuffer(std::move(packet)), opcode_(packet.opcode_),
+            chunkOffset_(packet.chunkOffset_), streamSize_(packet.streamSize_)
+        {
+        }
+
+        WorldPacket &operator=(const WorldPacket &packet) = default;
+        WorldPacket &operator=(WorldPacket &&packet) = default;
  
-        void Initialize(Opcodes opcode, size_t newres = 200)
+        void Initialize(Opcodes opcode, size_t newres = 0)
         {
             clear();
             storage_.reserve(newres);
             opcode_ = opcode;
+            chunkOffset_ = streamSize_ = 0;
         }
  
         Opcodes GetOpcode() const { return opcode_; }
         void SetOpcode(Opcodes opcode) { opcode_ = opcode; }
+
+        // Streamed packets are delivered in chunks, the last one ends at the stream size
+        uint32 GetChunkOffset() const { return chunkOffset_; }
+        uint32 GetStreamSize() const { return streamSize_; }
+        bool IsLastChunk() const { return chunkOffset_ + size() == streamSize_; }
+        void SetChunk(uint32 offset, uint32 streamSize) { chunkOffset_ = offset; streamSize_ = streamSize; }
  
     protected:
         Opcodes opcode_;
+        uint32 chunkOffset_;
+        uint32 streamSize_;
 };
+
+// Returns the packet to the PacketPool
+struct WorldPacketDeleter
+{
+    void operator()(WorldPacket* packet) const;
+};
+
+typedef std::unique_ptr<WorldPacket, WorldPacketDeleter> WorldPacketPtr;
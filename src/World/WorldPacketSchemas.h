@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Character.h"
+#include "ChatMgr.h"
+#include "Network/PacketSchema.h"
+
+// Layouts of the world packets that are read or written through PacketSchema
+
+typedef PacketSchema<
+    SCHEMA_FIELD(Position2D, X),
+    SCHEMA_FIELD(Position2D, Y),
+    SCHEMA_FIELD(Position3D, Z)
+> CharacterPositionSchema;
+
+typedef PacketSchema<
+    SCHEMA_FIELD(CharacterDisplay, Skin),
+    SCHEMA_FIELD(CharacterDisplay, Face),
+    SCHEMA_FIELD(CharacterDisplay, HairStyle),
+    SCHEMA_FIELD(CharacterDisplay, HairColor),
+    SCHEMA_FIELD(CharacterDisplay, FacialHair)
+> CharacterDisplaySchema;
+
+typedef PacketSchema<
+    SCHEMA_FIELD(CharacterPet, DisplayId),
+    SCHEMA_FIELD(CharacterPet, Level),
+    SCHEMA_FIELD(CharacterPet, Family)
+> CharacterPetSchema;
+
+typedef PacketSchema<
+    SCHEMA_FIELD(CharacterItems, DisplayId),
+    SCHEMA_FIELD(CharacterItems, InventoryType),
+    SCHEMA_FIELD(CharacterItems, EnchantAuraId)
+> CharacterItemSchema;
+
+typedef PacketSchema<
+    SCHEMA_FIELD(CharacterBags, DisplayId),
+    SCHEMA_FIELD(CharacterBags, InventoryType),
+    SCHEMA_FIELD(CharacterBags, EnchantId)
+> CharacterBagSchema;
+
+// One character of SMSG_CHAR_ENUM, everything after the name is checked at once
+typedef PacketSchema<
+    SCHEMA_FIELD(Character, Guid),
+    SCHEMA_STRING(Character, Name),
+    SCHEMA_FIELD(Character, Race),
+    SCHEMA_FIELD(Character, Class),
+    SCHEMA_FIELD(Character, Gender),
+    SCHEMA_NESTED(Character, Display, CharacterDisplaySchema),
+    SCHEMA_FIELD(Character, Level),
+    SCHEMA_FIELD(Character, AreaId),
+    SCHEMA_FIELD(Character, MapId),
+    SCHEMA_NESTED(Character, Position, CharacterPositionSchema),
+    SCHEMA_FIELD(Character, GuildId),
+    SCHEMA_FIELD(Character, Flags),
+    SCHEMA_FIELD(Character, CustomizationFlags),
+    SCHEMA_FIELD(Character, IsFirstLogin),
+    SCHEMA_NESTED(Character, Pet, CharacterPetSchema),
+    SCHEMA_ARRAY(Character, Items, CharacterItemSchema),
+    SCHEMA_ARRAY(Character, Bags, CharacterBagSchema)
+> CharacterSchema;
+
+// SMSG_AUTH_CHALLENGE
+struct AuthChallenge
+{
+    uint32 Unk;
+    uint32 ServerSeed;
+    uint8 EncryptionSeed[2][16];
+};
+
+typedef PacketSchema<
+    SCHEMA_FIELD(AuthChallenge, Unk),
+    SCHEMA_FIELD(AuthChallenge, ServerSeed),
+    SCHEMA_BYTES(AuthChallenge, EncryptionSeed)
+> AuthChallengeSchema;
+
+// CMSG_AUTH_SESSION up to the compressed addon data
+struct AuthSessionHeader
+{
+    uint32 Build;
+    std::string Account;
+    uint32 ClientSeed;
+    uint32 RealmId;
+    uint8 Digest[20];
+};
+
+typedef PacketSchema<
+    SCHEMA_FIELD(AuthSessionHeader, Build),
+    SchemaPad<4>,
+    SCHEMA_STRING(AuthSessionHeader, Account),
+    SchemaPad<4>,
+    SCHEMA_FIELD(AuthSessionHeader, ClientSeed),
+    SchemaPad<8>,
+    SCHEMA_FIELD(AuthSessionHeader, RealmId),
+    SchemaPad<8>,
+    SCHEMA_BYTES(AuthSessionHeader, Digest)
+> AuthSessionHeaderSchema;
+
+// Fixed part of SMSG_MESSAGECHAT, the rest depends on the chat type
+typedef PacketSchema<
+    SCHEMA_FIELD(ChatMessage, Type),
+    SCHEMA_FIELD(ChatMessage, Language),
+    SCHEMA_FIELD(ChatMessage, SenderGUID),
+    SCHEMA_FIELD(ChatMessage, Flags)
+> ChatMessageHeaderSchema;
@@ -22,25 +22,31 @@
 #include <future>
 #include <sstream>
 #include "EventMgr.h"
-
-struct WorldOpcodeHandler
-{
-    Opcodes opcode;
-    std::function<void(WorldPacket&)> callback;
-};
+#include "PacketPool.h"
+#include "Config.h"
 
 WorldSession::WorldSession(std::shared_ptr<Session> session) : session_(session), socket_(this), serverSeed_(0), chatMgr_(this), playerNames_("cache_players.dat"), ping_(0), lastPingTime_(0)
 {
     clientSeed_ = static_cast<uint32>(time(nullptr));
     playerNames_.Load();
+
+    socket_.SetInlineDispatch(InlineDispatch);
 }
 
 WorldSession::~WorldSession()
 {
+    // No handler or event may run while the members are destroyed
+    socket_.Disconnect();
+    eventMgr_.Stop();
+
     playerNames_.Save();
 }
 
-#define BIND_OPCODE_HANDLER(a, b) { a, std::bind(&WorldSession::b, this, std::placeholders::_1) }
+#define BIND_OPCODE_HANDLER(a, b) { a, &WorldSession::b, false }
+
+// The handler is called once per chunk of the body (see WorldPacket::GetChunkOffset),
+// so packets of any size are accepted without being buffered as a whole
+#define BIND_STREAM_HANDLER(a, b) { a, &WorldSession::b, true }
 
 const std::vector<WorldOpcodeHandler> WorldSession::GetOpcodeHandlers()
 {
@@ -69,32 +75,45 @@ const std::vector<WorldOpcodeHandler> WorldSession::GetOpcodeHandlers()
     };
 }
 
-void WorldSession::HandlePacket(std::shared_ptr<WorldPacket> recvPacket)
+WorldOpcodeHandler const& WorldSession::GetOpcodeHandler(Opcodes opcode)
 {
-    static const std::vector<WorldOpcodeHandler> handlers = GetOpcodeHandlers();
+    static const std::vector<WorldOpcodeHandler> table = []() {
+        std::vector<WorldOpcodeHandler> table(NUM_MSG_TYPES, WorldOpcodeHandler{ MSG_NULL_ACTION, nullptr, false });
+
+        for (WorldOpcodeHandler const& handler : GetOpcodeHandlers())
+            table[handler.opcode] = handler;
 
-    auto itr = std::find_if(handlers.begin(), handlers.end(), [recvPacket](const WorldOpcodeHandler& handler) {
-        return recvPacket->GetOpcode() == handler.opcode;
-    });
+        return table;
+    }();
+
+    return table[opcode];
+}
 
-    if (itr == handlers.end())
+void WorldSession::HandlePacket(WorldPacket &recvPacket)
+{
+    if (recvPacket.GetOpcode() >= NUM_MSG_TYPES)
+        return;
+
+    WorldOpcodeHandler const& handler = GetOpcodeHandler(recvPacket.GetOpcode());
+
+    if (!handler.callback)
         return;
 
     try
     {
-        itr->callback(*recvPacket);
+        (this->*handler.callback)(recvPacket);
     }
     catch (ByteBufferException const& exception)
     {
         error("%s", "ByteBufferException occured while handling a world packet!");
-        error("Opcode: 0x%04x", recvPacket->GetOpcode());
+        error("Opcode: 0x%04x", recvPacket.GetOpcode());
         error("%s", exception.what());
     }
 }
 
-void WorldSession::SendPacket(WorldPacket &packet)
+void WorldSession::SendPacket(WorldPacket &&packet)
 {
-    socket_.EnqueuePacket(packet);
+    socket_.EnqueuePacket(std::move(packet));
 }
 
 void WorldSession::Enter()
@@ -104,12 +123,14 @@ void WorldSession::Enter()
     
     eventMgr_.Stop();
     {
+        // Triggered by the socket whenever a packet is queued
         std::shared_ptr<Event> packetProcessEvent(new Event(EVENT_PROCESS_INCOMING));
-        packetProcessEvent->SetPeriod(10);
         packetProcessEvent->SetEnabled(true);
         packetProcessEvent->SetCallback([this]() {
-            while (std::shared_ptr<WorldPacket> packet = socket_.GetNextPacket())
-                HandlePacket(packet);
+            std::lock_guard<std::mutex> lock(sessionMutex_);
+
+            while (WorldPacketPtr packet = socket_.GetNextPacket())
+                HandlePacket(*packet);
         });
 
         eventMgr_.AddEvent(packetProcessEvent);
@@ -118,8 +139,10 @@ void WorldSession::Enter()
         keepAliveEvent->SetPeriod(MINUTE * IN_MILLISECONDS);
         keepAliveEvent->SetEnabled(false);
         keepAliveEvent->SetCallback([this]() {
+            std::lock_guard<std::mutex> lock(sessionMutex_);
+
             WorldPacket packet(CMSG_KEEP_ALIVE, 0);
-            SendPacket(packet);
+            SendPacket(std::move(packet));
         });
 
         eventMgr_.AddEvent(keepAliveEvent);
@@ -128,6 +151,7 @@ void WorldSession::Enter()
         pingEvent->SetPeriod((MINUTE / 2) * IN_MILLISECONDS);
         pingEvent->SetEnabled(false);
         pingEvent->SetCallback([this]() {
+            std::lock_guard<std::mutex> lock(sessionMutex_);
             SendPing();
         });
 
@@ -137,6 +161,7 @@ void WorldSession::Enter()
         saveEvent->SetPeriod(MINUTE * IN_MILLISECONDS);
         saveEvent->SetEnabled(true);
         saveEvent->SetCallback([this]() {
+            std::lock_guard<std::mutex> lock(sessionMutex_);
             playerNames_.Save();
         });
 
@@ -160,6 +185,11 @@ void WorldSession::HandleConsoleCommand(std::string cmd)
     {
         socket_.Disconnect();
     }
+    else if (cmd == "stats")
+    {
+        PacketPool::instance()->PrintStatistics();
+        socket_.PrintStatistics();
+    }
 }
 
 WorldSocket* WorldSession::GetSocket()
@@ -29,9 +29,16 @@
 #include "ChatMgr.h"
 #include "WorldSocket.h"
 #include <queue>
+#include <mutex>
 
 struct WorldOpcodeHandler;
 
+// Threading: packet handlers and event callbacks always run with sessionMutex_
+// held, so they may use session state without further locking. Normally both run
+// on the session's event thread. With inline dispatch the I/O thread calls the
+// handler itself if it gets the lock without waiting and no older packet is still
+// queued, otherwise the packet is queued as usual. Inline handlers share the I/O
+// thread with other sessions, so they must not block.
 class WorldSession
 {
     friend class WorldSocket;
@@ -59,9 +66,14 @@ class WorldSession
         uint64 lastPingTime_;
         uint32 ping_;
 
-        const std::vector<WorldOpcodeHandler> GetOpcodeHandlers();
-        void HandlePacket(std::shared_ptr<WorldPacket> recvPacket);
-        void SendPacket(WorldPacket &packet);
+        std::mutex sessionMutex_;
+
+        static const std::vector<WorldOpcodeHandler> GetOpcodeHandlers();
+
+        // Indexed by opcode, built from GetOpcodeHandlers on first use
+        static WorldOpcodeHandler const& GetOpcodeHandler(Opcodes opcode);
+        void HandlePacket(WorldPacket &recvPacket);
+        void SendPacket(WorldPacket &&packet);
 
     // AuthHandler.cpp
     private:
@@ -93,3 +105,10 @@ class WorldSession
         void SendNameQuery(ObjectGuid guid);
         void HandleNameQueryResponse(WorldPacket &recvPacket);
 };
+
+struct WorldOpcodeHandler
+{
+    Opcodes opcode;
+    void (WorldSession::*callback)(WorldPacket &recvPacket);
+    bool stream;                                        // Called once per chunk of the body
+};
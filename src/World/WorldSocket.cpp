@@ -17,13 +17,23 @@
 
 #include "WorldSocket.h"
 #include "WorldSession.h"
+#include "PacketPool.h"
+#include <algorithm>
+#include <array>
 
 #ifndef _WIN32
     #include <netinet/in.h>
 #endif
 
-WorldSocket::WorldSocket(WorldSession* session) : session_(session)
+WorldSocket::WorldSocket(WorldSession* session) : session_(session), receiveQueue_(RECEIVE_QUEUE_SIZE), receiveStalled_(false), inlineDispatch_(false)
 {
+    for (uint32 i = 0; i < MAX_SEND_PRIORITY; ++i)
+        sendQueues_[i].reset(new SPSCQueue<QueuedPacket>(SEND_QUEUE_SIZE));
+
+    for (std::atomic<uint32>& count : discardCounts_)
+        count = 0;
+
+    ResetState();
 }
 
 WorldSocket::~WorldSocket()
@@ -31,157 +41,538 @@ WorldSocket::~WorldSocket()
     if (IsConnected())
         Disconnect();
 
-    if (senderThread_.joinable())
-        senderThread_.join();
-
-    if (receiverThread_.joinable())
-        receiverThread_.join();
+    // The I/O thread may still be finishing a callback that disconnected us
+    AsyncSocket::Disconnect();
 }
 
 bool WorldSocket::Connect(std::string address)
 {
     assert(!IsConnected());
 
-    if (senderThread_.joinable())
-        senderThread_.join();
-
-    if (receiverThread_.joinable())
-        receiverThread_.join();
-
     if (!TCPSocket::Connect(address))
         return false;
 
     packetCrypt_.Reset();
+    ResetState();
+
+    if (!Attach())
+    {
+        TCPSocket::Disconnect();
+        return false;
+    }
 
-    senderThread_ = std::thread(&WorldSocket::RunSenderThread, this);
-    receiverThread_ = std::thread(&WorldSocket::RunReceiverThread, this);
     return true;
 }
 
 void WorldSocket::Disconnect()
 {
-    TCPSocket::Disconnect();
-   
-    std::lock_guard<std::recursive_mutex> sendLock(sendMutex_);
+    if (!IsConnected())
+        return;
 
-    while (!sendQueue_.empty())
-        sendQueue_.pop();
+    // Once this returns the I/O thread is done with the socket. The queues are
+    // left to their consumers: GetNextPacket drops what was received and the
+    // unsent packets are released by the next Connect.
+    AsyncSocket::Disconnect();
 
-    std::lock_guard<std::recursive_mutex> receiveLock(receiveMutex_);
+    print("%s", "Disconnected from the server.");
+}
 
-    while (!receiveQueue_.empty())
-        receiveQueue_.pop();
+void WorldSocket::ResetState()
+{
+    for (uint32 i = 0; i < MAX_SEND_PRIORITY; ++i)
+    {
+        sendQueues_[i]->Clear();
+
+        SendQueueStats& stats = sendStats_[i];
+        stats.depth = 0;
+        stats.sent = 0;
+        stats.totalWait = 0;
+        stats.maxWait = 0;
+    }
+
+    sendBatch_.clear();
+    sendHeaders_.clear();
+    sendBuffers_.clear();
+    sendIndex_ = 0;
+    sendOffset_ = 0;
+
+    receiveQueue_.Clear();
+    receiveStalled_ = false;
+    readBuffer_.Reset();
+    headerDecrypted_ = 0;
+    packet_.reset();
+    bodyRead_ = 0;
+    discard_ = 0;
+    streamSize_ = 0;
+    streamRemaining_ = 0;
 }
 
-void WorldSocket::EnqueuePacket(WorldPacket &packet)
+void WorldSocket::EnqueuePacket(WorldPacket &&packet)
 {
-    std::shared_ptr<WorldPacket> copy(new WorldPacket(packet));
+    if (!IsConnected())
+        return;
+
+    // Small packets live in inline storage, copy them into a pooled packet so sending
+    // them allocates nothing. Larger ones hand over their heap storage instead.
+    WorldPacketPtr queued;
+
+    if (packet.IsInline())
+    {
+        queued = PacketPool::instance()->Acquire(packet.GetOpcode(), packet.size());
+        *queued = std::move(packet);
+    }
+    else
+        queued.reset(new WorldPacket(std::move(packet)));
+
+    SendPriority priority = GetSendPriority(queued->GetOpcode());
+    QueuedPacket entry = { std::move(queued), std::chrono::steady_clock::now() };
+
+    if (!sendQueues_[priority]->Push(entry))
+    {
+        error("World socket send queue is full (%u packets), disconnecting!", uint32(sendQueues_[priority]->GetCapacity()));
+        Disconnect();
+        return;
+    }
 
-    std::lock_guard<std::recursive_mutex> lock(sendMutex_);
-    sendQueue_.push(copy);
+    sendStats_[priority].depth.fetch_add(1, std::memory_order_relaxed);
+    RequestWrite();
 }
 
-std::shared_ptr<WorldPacket> WorldSocket::GetNextPacket()
+WorldPacketPtr WorldSocket::GetNextPacket()
 {
-    if (receiveQueue_.empty())
+    if (!IsConnected())
+    {
+        receiveQueue_.Clear();
+        return nullptr;
+    }
+
+    WorldPacketPtr packet;
+
+    if (!receiveQueue_.Pop(packet))
         return nullptr;
 
-    std::lock_guard<std::recursive_mutex> lock(receiveMutex_);
-    std::shared_ptr<WorldPacket> packet = receiveQueue_.front();
-    receiveQueue_.pop();
+    // Pairs with the fence in ReadPackets, either we see the flag or it sees the free slot
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (receiveStalled_.exchange(false))
+        RequestRead();
 
     return packet;
 }
 
-void WorldSocket::RunSenderThread()
+void WorldSocket::OnWritable()
 {
     while (IsConnected())
     {
-        if (!sendQueue_.empty())
+        if (sendIndex_ == sendBuffers_.size() && !PrepareSendBatch())
+            return;
+
+        // The first buffer may be partially written already
+        SocketBuffer buffers[MAX_SEND_BUFFERS];
+        uint32 count = 0;
+
+        for (size_t i = sendIndex_; i < sendBuffers_.size() && count < MAX_SEND_BUFFERS; ++i)
+            buffers[count++] = sendBuffers_[i];
+
+        buffers[0].data += sendOffset_;
+        buffers[0].length -= sendOffset_;
+
+        int32 result = TrySend(buffers, count);
+
+        if (!result)
+        {
+            // Socket buffer is full, continue once it drains
+            if (IsConnected())
+                RequestWrite();
+
+            return;
+        }
+
+        // Skip the buffers that were written completely
+        size_t sent = result;
+
+        while (sent)
         {
-            // Acquire next packet
-            std::lock_guard<std::recursive_mutex> lock(sendMutex_);
-            std::shared_ptr<WorldPacket> packet = sendQueue_.front();
-            sendQueue_.pop();
+            size_t remaining = sendBuffers_[sendIndex_].length - sendOffset_;
+
+            if (sent < remaining)
+            {
+                sendOffset_ += sent;
+                break;
+            }
+
+            sent -= remaining;
+            sendOffset_ = 0;
+            ++sendIndex_;
+        }
+    }
+}
+
+void WorldSocket::CollectCiphers(std::vector<RC4*>& ciphers)
+{
+    packetCrypt_.CollectCiphers(ciphers);
+}
+
+bool WorldSocket::PrepareSendBatch()
+{
+    sendBatch_.clear();
+    sendHeaders_.clear();
+    sendBuffers_.clear();
+    sendIndex_ = 0;
+    sendOffset_ = 0;
+
+    // Control packets jump ahead of bulk ones queued earlier, bulk traffic is capped
+    // so a control packet queued meanwhile waits for one batch at most
+    TakeSendPackets(SEND_PRIORITY_CONTROL, SEND_QUEUE_SIZE);
+    TakeSendPackets(SEND_PRIORITY_BULK, SEND_BULK_BATCH);
+
+    if (sendBatch_.empty())
+        return false;
+
+    // Headers are encrypted in batch order, the stream cipher depends on it
+    sendHeaders_.resize(sendBatch_.size() * 6);
 
-            ByteBuffer prepared;
+    for (size_t i = 0; i < sendBatch_.size(); ++i)
+    {
+        WorldPacket* packet = sendBatch_[i].get();
+        uint8* header = &sendHeaders_[i * 6];
 
-            uint16 size = htons(packet->size() + 4);
-            uint32 opcode = uint32(packet->GetOpcode());
+        uint16 size = htons(packet->size() + 4);
+        uint32 opcode = uint32(packet->GetOpcode());
 
-            packetCrypt_.EncryptSend((uint8*)&size, 2);
-            packetCrypt_.EncryptSend((uint8*)&opcode, 4);
+        std::memcpy(header, &size, 2);
+        std::memcpy(header + 2, &opcode, 4);
+        packetCrypt_.EncryptSend(header, 6);
 
-            prepared << size;
-            prepared << opcode;
+        // Every header after this one is encrypted
+        if (packet->GetOpcode() == CMSG_AUTH_SESSION)
+            packetCrypt_.Initialize(&session_->session_->GetKey());
+    }
 
-            if (!packet->empty())
-                prepared.append(packet->contents(), packet->size());
+    // The arena is not resized anymore, so pointers into it stay valid
+    for (size_t i = 0; i < sendBatch_.size(); ++i)
+    {
+        WorldPacket* packet = sendBatch_[i].get();
 
-            Send(prepared.contents(), prepared.size());
+        SocketBuffer header = { &sendHeaders_[i * 6], 6 };
+        sendBuffers_.push_back(header);
 
-            if (packet->GetOpcode() == CMSG_AUTH_SESSION)
-                packetCrypt_.Initialize(&session_->session_->GetKey());
+        if (!packet->empty())
+        {
+            SocketBuffer body = { packet->contents(), uint32(packet->size()) };
+            sendBuffers_.push_back(body);
         }
-        else
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
+
+    return true;
 }
 
-void WorldSocket::RunReceiverThread()
+void WorldSocket::TakeSendPackets(SendPriority priority, size_t limit)
 {
-    uint8 header[5];
-    uint32 size;
-    Opcodes opcode;
+    SendQueueStats& stats = sendStats_[priority];
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    QueuedPacket entry;
+    size_t count = 0;
+
+    while (count < limit && sendQueues_[priority]->Pop(entry))
+    {
+        // Queued after the clock was read
+        if (entry.Time > now)
+            now = std::chrono::steady_clock::now();
+
+        uint64 wait = std::chrono::duration_cast<std::chrono::microseconds>(now - entry.Time).count();
+
+        stats.totalWait.store(stats.totalWait.load(std::memory_order_relaxed) + wait, std::memory_order_relaxed);
+        if (wait > stats.maxWait.load(std::memory_order_relaxed))
+            stats.maxWait.store(wait, std::memory_order_relaxed);
+
+        sendBatch_.push_back(std::move(entry.Packet));
+        ++count;
+    }
+
+    if (count)
+    {
+        stats.depth.fetch_sub(uint32(count), std::memory_order_relaxed);
+        stats.sent.store(stats.sent.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+    }
+}
+
+void WorldSocket::OnReadable()
+{
+    // Finish what is already buffered, reading may have stopped on a full receive queue
+    if (!ReadPackets())
+        return;
 
     while (IsConnected())
     {
-        // Read normal header (4 bytes)
-        Read((char*)&header[0], 4);
+        // Only a partial header can be left over, so this moves at most a few bytes
+        readBuffer_.Normalize();
 
-        if (!IsConnected())
-            break;
+        size_t space = readBuffer_.GetRemainingSpace();
+        int32 result = TryRead(readBuffer_.GetWritePointer(), space);
 
-        packetCrypt_.DecryptReceived(&header[0], 4);
+        if (!result)
+            return;
 
-        // Read additional header byte if necessary (1 byte)
-        if (header[0] & 0x80)
+        readBuffer_.WriteCompleted(result);
+
+        // The rest stays in the kernel until GetNextPacket asks for more
+        if (!ReadPackets())
+            return;
+
+        // A short read drained the socket, new data will raise another edge
+        if (size_t(result) < space)
+            return;
+    }
+}
+
+bool WorldSocket::ReadPackets()
+{
+    while (IsConnected())
+    {
+        if (discard_)
         {
-            Read((char*)&header[4], 1);
+            size_t length = std::min<size_t>(discard_, readBuffer_.GetActiveSize());
+            readBuffer_.ReadCompleted(length);
+            discard_ -= length;
 
-            if (!IsConnected())
-                break;
+            if (discard_)
+                return true;
+        }
+
+        if (!packet_)
+        {
+            if (!ReadHeader())
+                return true;
 
-            packetCrypt_.DecryptReceived(&header[4], 1);
+            // Unhandled, the body is skipped in place
+            if (!packet_)
+                continue;
         }
 
-        // Calculate size and opcode
-        if (header[0] & 0x80)
+        // Copy as much of the body as we have
+        size_t length = std::min<size_t>(packet_->size() - bodyRead_, readBuffer_.GetActiveSize());
+
+        if (length)
         {
-            size = ((header[0] & 0x7F) << 16) | (header[1] << 8) | header[2];
-            opcode = static_cast<Opcodes>(header[3] | (header[4] << 8));
+            std::memcpy(packet_->contents() + bodyRead_, readBuffer_.GetReadPointer(), length);
+            readBuffer_.ReadCompleted(length);
+            bodyRead_ += length;
         }
-        else
+
+        if (bodyRead_ < packet_->size())
+            return true;
+
+        Opcodes opcode = packet_->GetOpcode();
+
+        if (DispatchInline())
         {
-            size = (header[0] << 8) | header[1];
-            opcode = static_cast<Opcodes>(header[2] | (header[3] << 8));
+            if (streamRemaining_)
+                NextChunk(opcode);
+
+            continue;
         }
 
-        size -= sizeof(Opcodes);
+        if (!receiveQueue_.Push(packet_))
+        {
+            // Retry after raising the flag, otherwise the session could have emptied
+            // the queue in between without knowing that we are waiting
+            receiveStalled_ = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (!receiveQueue_.Push(packet_))
+                return false;
+        }
+
+        session_->eventMgr_.TriggerEvent(EVENT_PROCESS_INCOMING);
+
+        if (streamRemaining_)
+            NextChunk(opcode);
+    }
 
-        // Read body
-        std::shared_ptr<WorldPacket> packet(new WorldPacket(opcode, size));
-        packet->resize(size);
+    return true;
+}
+
+bool WorldSocket::DispatchInline()
+{
+    // Queued packets go first, and never wait for the session, the lane has other sockets
+    if (!inlineDispatch_ || !receiveQueue_.IsEmpty())
+        return false;
 
-        if (size)
-            Read(reinterpret_cast<char*>(packet->contents()), size);
+    std::unique_lock<std::mutex> lock(session_->sessionMutex_, std::try_to_lock);
 
-        if (!IsConnected())
-            break;
+    if (!lock.owns_lock())
+        return false;
 
-        std::lock_guard<std::recursive_mutex> lock(receiveMutex_);
-        receiveQueue_.push(packet);
+    WorldPacketPtr packet = std::move(packet_);
+    session_->HandlePacket(*packet);
+    return true;
+}
+
+bool WorldSocket::ReadHeader()
+{
+    uint8* header = readBuffer_.GetReadPointer();
+    size_t available = readBuffer_.GetActiveSize();
+
+    // Normal header (4 bytes)
+    if (available < 4)
+        return false;
+
+    if (headerDecrypted_ < 4)
+    {
+        packetCrypt_.DecryptReceived(header, 4);
+        headerDecrypted_ = 4;
     }
 
-    print("%s", "Disconnected from the server.");
+    // Additional header byte for large packets (1 byte)
+    uint32 headerLength = (header[0] & 0x80) ? 5 : 4;
+
+    if (available < headerLength)
+        return false;
+
+    if (headerDecrypted_ < headerLength)
+        packetCrypt_.DecryptReceived(&header[4], 1);
+
+    headerDecrypted_ = 0;
+
+    // Calculate size and opcode
+    uint32 size;
+    Opcodes opcode;
+
+    if (header[0] & 0x80)
+    {
+        size = ((header[0] & 0x7F) << 16) | (header[1] << 8) | header[2];
+        opcode = static_cast<Opcodes>(header[3] | (header[4] << 8));
+    }
+    else
+    {
+        size = (header[0] << 8) | header[1];
+        opcode = static_cast<Opcodes>(header[2] | (header[3] << 8));
+    }
+
+    readBuffer_.ReadCompleted(headerLength);
+
+    if (size < sizeof(Opcodes))
+    {
+        error("Malformed world packet header (size: %u)", size);
+        Disconnect();
+        return false;
+    }
+
+    size -= sizeof(Opcodes);
+
+    // Only the header is encrypted, so nothing is lost by not reading the body
+    bool handled = opcode < NUM_MSG_TYPES && WorldSession::GetOpcodeHandler(opcode).callback;
+
+    if (handled && WorldSession::GetOpcodeHandler(opcode).stream)
+    {
+        streamSize_ = size;
+        streamRemaining_ = size;
+        NextChunk(opcode);
+        return true;
+    }
+
+    if (handled && size > MAX_PACKET_SIZE)
+    {
+        error("World packet 0x%03X is too large (size: %u), skipping it", uint32(opcode), size);
+        handled = false;
+    }
+
+    if (!handled)
+    {
+        if (opcode < NUM_MSG_TYPES)
+            discardCounts_[opcode].store(discardCounts_[opcode].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        discard_ = size;
+        return true;
+    }
+
+    packet_ = PacketPool::instance()->Acquire(opcode, size);
+    packet_->resize(size);
+    bodyRead_ = 0;
+    return true;
+}
+
+void WorldSocket::NextChunk(Opcodes opcode)
+{
+    uint32 length = streamRemaining_ < STREAM_CHUNK_SIZE ? streamRemaining_ : STREAM_CHUNK_SIZE;
+
+    packet_ = PacketPool::instance()->Acquire(opcode, length);
+    packet_->resize(length);
+    packet_->SetChunk(streamSize_ - streamRemaining_, streamSize_);
+
+    streamRemaining_ -= length;
+    bodyRead_ = 0;
+}
+
+SendPriority WorldSocket::GetSendPriority(Opcodes opcode)
+{
+    static std::array<uint8, NUM_MSG_TYPES> const table = []()
+    {
+        std::array<uint8, NUM_MSG_TYPES> priorities;
+        priorities.fill(SEND_PRIORITY_BULK);
+
+        static Opcodes const control[] =
+        {
+            CMSG_AUTH_SESSION,
+            CMSG_PING,
+            CMSG_KEEP_ALIVE,
+            CMSG_TIME_SYNC_RESP
+        };
+
+        for (Opcodes opcode : control)
+            priorities[opcode] = SEND_PRIORITY_CONTROL;
+
+        return priorities;
+    }();
+
+    return opcode < NUM_MSG_TYPES ? SendPriority(table[opcode]) : SEND_PRIORITY_BULK;
+}
+
+uint32 WorldSocket::GetSendQueueDepth(SendPriority priority) const
+{
+    return sendStats_[priority].depth.load(std::memory_order_relaxed);
+}
+
+uint64 WorldSocket::GetAverageSendWait(SendPriority priority) const
+{
+    uint64 sent = sendStats_[priority].sent.load(std::memory_order_relaxed);
+    return sent ? sendStats_[priority].totalWait.load(std::memory_order_relaxed) / sent : 0;
+}
+
+uint64 WorldSocket::GetMaxSendWait(SendPriority priority) const
+{
+    return sendStats_[priority].maxWait.load(std::memory_order_relaxed);
+}
+
+uint32 WorldSocket::GetDiscardCount(Opcodes opcode) const
+{
+    if (opcode >= NUM_MSG_TYPES)
+        return 0;
+
+    return discardCounts_[opcode].load(std::memory_order_relaxed);
+}
+
+void WorldSocket::PrintStatistics() const
+{
+    static char const* const priorityNames[MAX_SEND_PRIORITY] = { "control", "bulk" };
+
+    print("%s", "Send queues:");
+
+    for (uint32 i = 0; i < MAX_SEND_PRIORITY; ++i)
+    {
+        SendPriority priority = SendPriority(i);
+        print(" - %s: %u queued, %llu sent, wait avg %llu us, max %llu us", priorityNames[i], GetSendQueueDepth(priority),
+            (unsigned long long)sendStats_[i].sent.load(std::memory_order_relaxed),
+            (unsigned long long)GetAverageSendWait(priority), (unsigned long long)GetMaxSendWait(priority));
+    }
+
+    print("%s", "Discarded packets:");
+
+    for (uint32 opcode = 0; opcode < NUM_MSG_TYPES; ++opcode)
+    {
+        if (uint32 count = GetDiscardCount(Opcodes(opcode)))
+            print(" - 0x%03X: %u", opcode, count);
+    }
 }
\ No newline at end of file
@@ -18,16 +18,26 @@
 #pragma once
 
 #include "Define.h"
-#include "Network/TCPSocket.h"
+#include "Network/AsyncSocket.h"
+#include "Network/MessageBuffer.h"
+#include "Network/SPSCQueue.h"
 #include "Cryptography/PacketRC4.h"
 #include "WorldPacket.h"
-#include <queue>
-#include <thread>
-#include <mutex>
+#include <vector>
+#include <atomic>
+#include <chrono>
 
 class WorldSession;
 
-class WorldSocket : public TCPSocket
+// Outbound packets are queued per class, control packets always go out first
+enum SendPriority
+{
+    SEND_PRIORITY_CONTROL,                              // Session and timing packets (ping, time sync, keep alive)
+    SEND_PRIORITY_BULK,                                 // Everything else, sent in bounded batches
+    MAX_SEND_PRIORITY
+};
+
+class WorldSocket : public AsyncSocket
 {
     public:
         WorldSocket(WorldSession* session);
@@ -36,22 +46,82 @@ class WorldSocket : public TCPSocket
         bool Connect(std::string address) override;
         void Disconnect() override;
 
-        void EnqueuePacket(WorldPacket &packet);
-        std::shared_ptr<WorldPacket> GetNextPacket();
+        const static uint32 SEND_QUEUE_SIZE = 1024;     // Per priority class
+        const static uint32 SEND_BULK_BATCH = 64;       // Bulk packets taken per batch, control packets wait one batch at most
+        const static uint32 RECEIVE_QUEUE_SIZE = 4096;
+
+        // Larger packets are dropped unless their handler takes them as a stream
+        const static uint32 MAX_PACKET_SIZE = 0x100000;
+        const static uint32 STREAM_CHUNK_SIZE = 0x4000;
+
+        // Both must be called from the session's thread, the queues have a single producer and consumer
+        void EnqueuePacket(WorldPacket &&packet);
+        WorldPacketPtr GetNextPacket();
+
+        // Hands packets to WorldSession::HandlePacket on the I/O thread when possible
+        void SetInlineDispatch(bool enabled) { inlineDispatch_ = enabled; }
+
+        static SendPriority GetSendPriority(Opcodes opcode);
+
+        // Packets queued but not yet handed to the kernel, and how long they waited (microseconds)
+        uint32 GetSendQueueDepth(SendPriority priority) const;
+        uint64 GetAverageSendWait(SendPriority priority) const;
+        uint64 GetMaxSendWait(SendPriority priority) const;
+
+        // Packets dropped by the socket because no handler is registered for them
+        uint32 GetDiscardCount(Opcodes opcode) const;
+        void PrintStatistics() const;
+    protected:
+        void OnReadable() override;
+        void OnWritable() override;
+        void CollectCiphers(std::vector<RC4*>& ciphers) override;
+
     private:
-        void RunSenderThread();
-        void RunReceiverThread();
+        void ResetState();
+        bool PrepareSendBatch();
+        void TakeSendPackets(SendPriority priority, size_t limit);
+        bool ReadHeader();
+        bool DispatchInline();
+        void NextChunk(Opcodes opcode);
+        bool ReadPackets();
 
     private:
         WorldSession* session_;
 
-        std::thread senderThread_;
-        std::recursive_mutex sendMutex_;
-        std::queue<std::shared_ptr<WorldPacket>> sendQueue_;
+        struct QueuedPacket
+        {
+            WorldPacketPtr Packet;
+            std::chrono::steady_clock::time_point Time;
+        };
+
+        // Updated by the I/O thread, except depth which the producer raises
+        struct SendQueueStats
+        {
+            std::atomic<uint32> depth;
+            std::atomic<uint64> sent;
+            std::atomic<uint64> totalWait;
+            std::atomic<uint64> maxWait;
+        };
+
+        std::unique_ptr<SPSCQueue<QueuedPacket>> sendQueues_[MAX_SEND_PRIORITY];
+        SendQueueStats sendStats_[MAX_SEND_PRIORITY];
+        std::vector<WorldPacketPtr> sendBatch_;         // Packets being written, keeps their bodies alive
+        std::vector<uint8> sendHeaders_;                // Encrypted headers of the batch
+        std::vector<SocketBuffer> sendBuffers_;         // Header and body of every packet in the batch
+        size_t sendIndex_;                              // First buffer that is not fully written
+        size_t sendOffset_;                             // Bytes of that buffer already written
 
-        std::thread receiverThread_;
-        std::recursive_mutex receiveMutex_;
-        std::queue<std::shared_ptr<WorldPacket>> receiveQueue_;
+        SPSCQueue<WorldPacketPtr> receiveQueue_;
+        std::atomic<bool> receiveStalled_;              // Reading stopped because receiveQueue_ was full
+        std::atomic<bool> inlineDispatch_;
+        MessageBuffer readBuffer_;
+        uint32 headerDecrypted_;                        // Header bytes at the read pointer that are already decrypted
+        WorldPacketPtr packet_;                         // Packet whose body is being read
+        uint32 bodyRead_;
+        uint32 discard_;                                // Body bytes of an unhandled packet still to skip
+        uint32 streamSize_;                             // Body size of the packet being streamed
+        uint32 streamRemaining_;                        // Body bytes of it not assigned to a chunk yet
+        std::atomic<uint32> discardCounts_[NUM_MSG_TYPES];
 
         PacketRC4 packetCrypt_;
-};
\ No newline at end of file
+};
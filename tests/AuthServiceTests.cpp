@@ -0,0 +1,342 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Test.h"
+#include "Auth/AuthService.h"
+#include "Auth/AuthPackets.h"
+#include "SHA1.h"
+#include <map>
+#include <sstream>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+// Many logins through one AuthService against an authserver played by the test, one
+// blocking thread per connection. Accounts are told apart by name: BADPASS ones are
+// registered with another password, so the client rejects the server's proof, and
+// UNKNOWN ones are refused by the challenge response.
+
+#ifndef _WIN32
+
+static uint8 const Modulus[32] =
+{
+    0xB7, 0x9B, 0x3E, 0x2A, 0x87, 0x82, 0x3C, 0xAB, 0x8F, 0x5E, 0xBF, 0xBF, 0x8E, 0xB1, 0x01, 0x08,
+    0x53, 0x50, 0x06, 0x29, 0x8B, 0x5B, 0xAD, 0xBD, 0x5B, 0x53, 0xE1, 0x89, 0x5E, 0x64, 0x4B, 0x89
+};
+
+static std::mutex serverMutex;
+static std::map<std::string, std::string> serverKeys;  // Session key the server derived per account
+
+static bool ReadAll(int fd, uint8* data, size_t length)
+{
+    while (length)
+    {
+        ssize_t result = read(fd, data, length);
+
+        if (result <= 0)
+            return false;
+
+        data += result;
+        length -= size_t(result);
+    }
+
+    return true;
+}
+
+static void WriteAll(int fd, ByteBuffer const& packet)
+{
+    uint8 const* data = packet.contents();
+    size_t length = packet.size();
+
+    while (length)
+    {
+        ssize_t result = write(fd, data, length);
+
+        if (result <= 0)
+            return;
+
+        data += result;
+        length -= size_t(result);
+    }
+}
+
+static void AppendNumber(ByteBuffer& packet, BigNumber const& number, int32 length)
+{
+    packet.append(number.AsByteArray(length).get(), length);
+}
+
+static std::string KeyString(BigNumber const& key)
+{
+    std::unique_ptr<uint8[]> bytes = key.AsByteArray(40);
+    return std::string((char const*)bytes.get(), 40);
+}
+
+static void Serve(int fd)
+{
+    // Logon challenge: the account name closes the packet, its length right before it
+    uint8 header[4];
+    uint16 length;
+
+    if (!ReadAll(fd, header, sizeof(header)))
+    {
+        close(fd);
+        return;
+    }
+
+    memcpy(&length, header + 2, sizeof(length));
+    std::vector<uint8> body(length);
+
+    if (!ReadAll(fd, body.data(), length) || length < 30 || body[29] + 30u != length)
+    {
+        close(fd);
+        return;
+    }
+
+    std::string account((char const*)&body[30], body[29]);
+    ByteBuffer packet;
+
+    if (account.find("UNKNOWN") != std::string::npos)
+    {
+        packet << uint8(AUTH_LOGON_CHALLENGE) << uint8(0) << uint8(WOW_FAIL_UNKNOWN_ACCOUNT);
+        WriteAll(fd, packet);
+        close(fd);
+        return;
+    }
+
+    std::string password = account.find("BADPASS") != std::string::npos ? "OTHER" : "PASS";
+
+    BigNumber N(Modulus, sizeof(Modulus));
+    BigNumber g(7);
+    BigNumber k(3);
+    BigNumber s, b;
+    s.SetRandom(32 * 8);
+    b.SetRandom(19 * 8);
+
+    SHA1 hCredentials;
+    hCredentials.Update(account + ":" + password);
+    hCredentials.Finalize();
+
+    SHA1 hx;
+    hx.Update(s);
+    hx.Update(hCredentials.GetDigest(), hCredentials.GetDigestLength());
+    hx.Finalize();
+
+    BigNumber x(hx.GetDigest(), hx.GetDigestLength());
+    BigNumber v = g.ModExp(x, N);
+    BigNumber B = (k * v + g.ModExp(b, N)) % N;
+
+    packet << uint8(AUTH_LOGON_CHALLENGE) << uint8(0) << uint8(WOW_SUCCESS);
+    AppendNumber(packet, B, 32);
+    packet << uint8(1) << uint8(7) << uint8(32);
+    AppendNumber(packet, N, 32);
+    AppendNumber(packet, s, 32);
+    packet.append(std::vector<uint8>(16).data(), 16);
+    packet << uint8(0);
+    WriteAll(fd, packet);
+
+    // Logon proof: opcode, A, M1, CRC and two zero bytes
+    uint8 proof[75];
+
+    if (!ReadAll(fd, proof, sizeof(proof)))
+    {
+        close(fd);
+        return;
+    }
+
+    BigNumber A(proof + 1, 32);
+    BigNumber M1(proof + 33, 20);
+
+    SHA1 hu;
+    hu.Update(A);
+    hu.Update(B);
+    hu.Finalize();
+
+    BigNumber u(hu.GetDigest(), hu.GetDigestLength());
+    BigNumber S = (A * v.ModExp(u, N)).ModExp(b, N);
+
+    std::unique_ptr<uint8[]> bS = S.AsByteArray(32);
+    uint8 SPart[2][16];
+
+    for (int i = 0; i < 16; ++i)
+    {
+        SPart[0][i] = bS[i * 2];
+        SPart[1][i] = bS[i * 2 + 1];
+    }
+
+    SHA1 hEven;
+    hEven.Update(SPart[0], 16);
+    hEven.Finalize();
+
+    SHA1 hOdd;
+    hOdd.Update(SPart[1], 16);
+    hOdd.Finalize();
+
+    uint8 bK[40];
+
+    for (int i = 0; i < 20; ++i)
+    {
+        bK[i * 2] = hEven.GetDigest()[i];
+        bK[i * 2 + 1] = hOdd.GetDigest()[i];
+    }
+
+    BigNumber K(bK, sizeof(bK));
+
+    {
+        std::lock_guard<std::mutex> lock(serverMutex);
+        serverKeys[account] = KeyString(K);
+    }
+
+    SHA1 hM2;
+    hM2.Update(A);
+    hM2.Update(M1);
+    hM2.Update(K);
+    hM2.Finalize();
+
+    packet.clear();
+    packet << uint8(AUTH_LOGON_PROOF) << uint8(WOW_SUCCESS);
+    packet.append(hM2.GetDigest(), hM2.GetDigestLength());
+    packet << uint32(0) << uint32(0) << uint16(0);
+    WriteAll(fd, packet);
+
+    // Realm list request, answered with one realm and a trailer Length counts too
+    uint8 request[5];
+
+    if (!ReadAll(fd, request, sizeof(request)))
+    {
+        close(fd);
+        return;
+    }
+
+    ByteBuffer realms;
+    realms << uint8(1) << uint8(0) << uint8(REALM_FLAG_NONE) << std::string("Realm") << std::string("127.0.0.1:8085");
+    realms << float(1.0f) << uint8(1) << uint8(1) << uint8(1);
+    realms << uint8(0x10) << uint8(0);
+
+    packet.clear();
+    packet << uint8(REALM_LIST) << uint16(sizeof(uint32) + sizeof(uint16) + realms.size()) << uint32(0) << uint16(1);
+    packet.append(realms.contents(), realms.size());
+    WriteAll(fd, packet);
+
+    // Wait for the client to hang up
+    uint8 rest;
+    ReadAll(fd, &rest, 1);
+    close(fd);
+}
+
+static void TestAuthService(uint32 sessionCount)
+{
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    socklen_t length = sizeof(address);
+    CHECK(bind(listener, (sockaddr*)&address, sizeof(address)) == 0 && listen(listener, int(sessionCount)) == 0);
+    CHECK(getsockname(listener, (sockaddr*)&address, &length) == 0);
+
+    std::mutex connectionMutex;
+    std::vector<std::thread> connections;
+
+    std::thread acceptor([&]()
+    {
+        int fd;
+
+        while ((fd = accept(listener, nullptr, nullptr)) >= 0)
+        {
+            std::lock_guard<std::mutex> lock(connectionMutex);
+            connections.push_back(std::thread(Serve, fd));
+        }
+    });
+
+    std::vector<std::shared_ptr<Session>> sessions;
+
+    for (uint32 i = 0; i < sessionCount; ++i)
+    {
+        std::string account = "ACCOUNT" + std::to_string(i);
+
+        switch (i % 8)
+        {
+            case 3: account += "BADPASS"; break;
+            case 5: account += "UNKNOWN"; break;
+            default: break;
+        }
+
+        // The last lines are the realm and the character
+        std::istringstream data("127.0.0.1:" + std::to_string(ntohs(address.sin_port)) + "\n" + account + "\npass\n" +
+            (i % 8 == 6 ? "Missing" : "Realm") + "\nCharacter\n");
+
+        std::shared_ptr<Session> session(new Session());
+        CHECK(session->LoadData(data));
+        sessions.push_back(session);
+    }
+
+    {
+        AuthService service(2);
+        std::vector<std::future<bool>> results;
+
+        for (std::shared_ptr<Session> const& session : sessions)
+            results.push_back(service.Authenticate(session));
+
+        for (uint32 i = 0; i < sessionCount; ++i)
+        {
+            bool expected = i % 8 != 3 && i % 8 != 5 && i % 8 != 6;
+
+            if (results[i].wait_for(std::chrono::seconds(10)) != std::future_status::ready)
+            {
+                CHECK(!"login finished");
+                continue;
+            }
+
+            CHECK(results[i].get() == expected);
+
+            if (!expected)
+                continue;
+
+            // The key both sides derived, and the realm picked by name
+            std::lock_guard<std::mutex> lock(serverMutex);
+            CHECK(serverKeys[sessions[i]->GetAccountName()] == KeyString(sessions[i]->GetKey()));
+            CHECK(sessions[i]->GetRealm().Name == "Realm" && sessions[i]->GetRealm().Address == "127.0.0.1:8085");
+        }
+    }
+
+    // Wakes the acceptor, the service is gone so every connection is closed by now
+    shutdown(listener, SHUT_RDWR);
+    close(listener);
+    acceptor.join();
+
+    for (std::thread& connection : connections)
+        connection.join();
+
+    CHECK(connections.size() == sessionCount);
+}
+
+#endif
+
+int main()
+{
+#ifndef _WIN32
+    TestAuthService(32);
+#endif
+
+    return TEST_RESULT();
+}
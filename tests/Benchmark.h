@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Define.h"
+#include <chrono>
+#include <cstdio>
+
+// Timing for the benchmark executables, which are built with the tests but left
+// out of ctest. A benchmark runs its body once to warm up, then the given number
+// of times, and prints the average time of one run
+static volatile uint64 benchmarkSink = 0;
+
+// Keeps the compiler from dropping a computation whose result is not used otherwise
+#define BENCHMARK_KEEP(value) (benchmarkSink = benchmarkSink + uint64(value))
+
+template <typename Body> static void Benchmark(char const* name, uint32 iterations, Body body)
+{
+    body();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (uint32 i = 0; i < iterations; ++i)
+        body();
+
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    printf("%-48s %12.1f ns\n", name, elapsed.count() / iterations);
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Benchmark.h"
+#include "ByteBuffer.h"
+#include <random>
+#include <vector>
+
+// WriteBits and ReadBits through the 64-bit accumulator against the bit at a
+// time loops they replaced, on a mix of field widths like the bit packed packets
+struct Field
+{
+    uint32 Value;
+    size_t Bits;
+};
+
+static void WriteBitsReference(ByteBuffer& buffer, uint32 value, size_t bits)
+{
+    for (int32 i = int32(bits) - 1; i >= 0; --i)
+        buffer.WriteBit((value >> i) & 1);
+}
+
+static uint32 ReadBitsReference(ByteBuffer& buffer, size_t bits)
+{
+    uint32 value = 0;
+
+    for (int32 i = int32(bits) - 1; i >= 0; --i)
+    {
+        if (buffer.ReadBit())
+            value |= (1 << i);
+    }
+
+    return value;
+}
+
+int main()
+{
+    size_t const widths[] = { 1, 1, 8, 5, 17, 24, 3, 32, 1, 12 };
+
+    std::mt19937 random(0x16);
+    std::vector<Field> fields(1000);
+
+    for (size_t i = 0; i < fields.size(); ++i)
+    {
+        fields[i].Bits = widths[i % (sizeof(widths) / sizeof(widths[0]))];
+        fields[i].Value = fields[i].Bits < 32 ? random() & ((1u << fields[i].Bits) - 1) : random();
+    }
+
+    uint32 const iterations = 2000;
+    ByteBuffer buffer(4096);
+
+    Benchmark("WriteBit per bit, 1000 fields", iterations, [&]()
+    {
+        buffer.clear();
+
+        for (Field const& field : fields)
+            WriteBitsReference(buffer, field.Value, field.Bits);
+
+        buffer.FlushBits();
+        BENCHMARK_KEEP(buffer.size());
+    });
+
+    Benchmark("WriteBits, 1000 fields", iterations, [&]()
+    {
+        buffer.clear();
+
+        for (Field const& field : fields)
+            buffer.WriteBits(field.Value, field.Bits);
+
+        buffer.FlushBits();
+        BENCHMARK_KEEP(buffer.size());
+    });
+
+    Benchmark("ReadBit per bit, 1000 fields", iterations, [&]()
+    {
+        buffer.rpos(0);
+        buffer.ResetBitPos();
+
+        for (Field const& field : fields)
+            BENCHMARK_KEEP(ReadBitsReference(buffer, field.Bits));
+    });
+
+    Benchmark("ReadBits, 1000 fields", iterations, [&]()
+    {
+        buffer.rpos(0);
+        buffer.ResetBitPos();
+
+        for (Field const& field : fields)
+            BENCHMARK_KEEP(buffer.ReadBits(field.Bits));
+    });
+
+    return 0;
+}
@@ -0,0 +1,602 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Test.h"
+#include "ByteBuffer.h"
+#include "ByteReader.h"
+#include "TCPSocket.h"
+#include <random>
+
+#ifndef _WIN32
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <arpa/inet.h>
+    #include <unistd.h>
+#endif
+
+// Checked reads never throw. A failed one zeroes its output, keeps the read
+// position and makes every later checked read fail too, until the error is cleared.
+
+static void TestCheckedReads()
+{
+    ByteBuffer buffer;
+    buffer << uint32(0x11223344) << uint8(0x55);
+
+    uint32 value32 = 0;
+    CHECK(buffer.TryRead(value32) && value32 == 0x11223344);
+    CHECK(buffer.rpos() == 4 && !buffer.HasReadError());
+
+    // One byte is left, a uint16 doesn't fit
+    uint16 value16 = 0xFFFF;
+    CHECK(!buffer.TryRead(value16));
+    CHECK(value16 == 0 && buffer.rpos() == 4);
+    CHECK(buffer.HasReadError());
+
+    // The error is sticky, even the byte that is there can't be read now
+    uint8 value8 = 0xFF;
+    CHECK(!buffer.TryRead(value8));
+    CHECK(value8 == 0 && buffer.rpos() == 4);
+    CHECK(!buffer.TryReadSkip(1) && buffer.rpos() == 4);
+
+    bool flag = true;
+    CHECK(!buffer.TryRead(flag) && !flag);
+
+    ObjectGuid guid(uint64(0x1234));
+    CHECK(!buffer.TryRead(guid) && guid.IsEmpty());
+
+    uint64 packed = 0x1234;
+    CHECK(!buffer.TryReadPackGUID(packed) && packed == 0);
+
+    std::string text = "stale";
+    CHECK(!buffer.TryRead(text) && text.empty());
+    CHECK(buffer.rpos() == 4);
+
+    buffer.ClearReadError();
+    CHECK(buffer.TryRead(value8) && value8 == 0x55);
+    CHECK(buffer.rpos() == 5 && !buffer.HasReadError());
+
+    // Reading up to the end is fine, one byte past it is not
+    CHECK(!buffer.TryRead(value8) && buffer.rpos() == 5);
+
+    // clear() resets the error, pooled packets are reused that way
+    buffer.clear();
+    CHECK(!buffer.HasReadError());
+    buffer << uint8(7);
+    CHECK(buffer.TryRead(value8) && value8 == 7);
+
+    ByteBuffer skipped;
+    skipped << uint32(1) << uint32(2);
+    CHECK(skipped.TryReadSkip<uint32>() && skipped.rpos() == 4);
+    CHECK(!skipped.TryReadSkip(5) && skipped.rpos() == 4 && skipped.HasReadError());
+
+    ByteBuffer guids;
+    guids << uint64(0x0102030405060708) << uint32(5);
+    CHECK(guids.TryRead(guid) && guid.GetRawValue() == 0x0102030405060708);
+    CHECK(!guids.TryRead(guid) && guid.IsEmpty() && guids.rpos() == 8);
+
+    // A string needs its terminator, an unterminated tail fails and stays unread
+    ByteBuffer strings;
+    strings << std::string("abc") << uint8('x') << uint8('y');
+    CHECK(strings.TryRead(text) && text == "abc");
+    CHECK(strings.rpos() == 4);
+    CHECK(!strings.TryRead(text) && text.empty() && strings.rpos() == 4);
+
+    // Packed guids: the mask announces two bytes, only one is there
+    ByteBuffer truncated;
+    truncated << uint8(0x03) << uint8(0xAA);
+    CHECK(!truncated.TryReadPackGUID(packed) && packed == 0);
+    CHECK(truncated.rpos() == 0 && truncated.HasReadError());
+
+    ByteBuffer complete;
+    complete << uint8(0x81) << uint8(0xAA) << uint8(0xBB);
+    CHECK(complete.TryReadPackGUID(packed) && packed == 0xBB000000000000AA);
+    CHECK(complete.rpos() == 3);
+    CHECK(!complete.TryReadPackGUID(packed) && packed == 0 && complete.rpos() == 3);
+}
+
+// Strings are found with memchr and handed out as views into the buffer
+
+static void TestStrings()
+{
+    StringView empty;
+    CHECK(empty.empty() && empty.size() == 0 && empty.ToString().empty());
+    CHECK(empty.find('a') == StringView::npos);
+
+    StringView word("realm");
+    CHECK(word.size() == 5 && word.find('l') == 3 && word.find('l', 4) == StringView::npos);
+    CHECK(word == StringView(std::string("realm")) && word != StringView("realms"));
+    CHECK(word.ToString() == "realm");
+
+    // A string, an empty one and a string ending the buffer
+    ByteBuffer buffer;
+    buffer << std::string("first") << std::string("") << std::string("last");
+
+    StringView first = buffer.ReadCString();
+    CHECK(first == StringView("first") && first.data() == (char const*)buffer.contents());
+    CHECK(buffer.rpos() == 6);
+
+    StringView none = buffer.ReadCString();
+    CHECK(none.empty() && buffer.rpos() == 7);
+
+    StringView last = buffer.ReadCString();
+    CHECK(last == StringView("last") && buffer.rpos() == buffer.size());
+
+    // Nothing left, the view is empty and the position stays at the end
+    CHECK(buffer.ReadCString().empty() && buffer.rpos() == buffer.size());
+
+    // A missing terminator is tolerated by the throwing reads, the string runs to the end
+    ByteBuffer unterminated;
+    unterminated << uint8('a') << uint8('b');
+    CHECK(unterminated.ReadCString() == StringView("ab") && unterminated.rpos() == 2);
+
+    std::string text;
+    unterminated.clear();
+    unterminated << uint8('c') << uint8('d');
+    unterminated >> text;
+    CHECK(text == "cd" && unterminated.rpos() == 2);
+
+    // Checked reads reject it and keep the position
+    StringView view("stale");
+    unterminated.clear();
+    unterminated << uint8('e');
+    CHECK(!unterminated.TryRead(view) && view.empty() && unterminated.rpos() == 0);
+
+    ByteBuffer checked;
+    checked << std::string("") << std::string("end");
+    CHECK(checked.TryRead(view) && view.empty() && checked.rpos() == 1);
+    CHECK(checked.TryRead(view) && view == StringView("end") && checked.rpos() == checked.size());
+    CHECK(!checked.TryRead(view) && checked.HasReadError());
+
+    // Fixed length fields stop at their first NUL but always consume the whole field
+    ByteBuffer fixed;
+    fixed << uint8('a') << uint8('b') << uint8(0) << uint8('c') << uint8('d') << uint8('e') << uint8('f');
+    CHECK(fixed.ReadString(5) == "ab" && fixed.rpos() == 5);
+    CHECK(fixed.ReadString(0).empty() && fixed.rpos() == 5);
+    CHECK(fixed.ReadString(2) == "ef" && fixed.rpos() == 7);
+
+    bool threw = false;
+
+    try { fixed.ReadString(1); }
+    catch (ByteBufferException const&) { threw = true; }
+
+    CHECK(threw && fixed.rpos() == 7);
+}
+
+// ByteReader mirrors the read side of ByteBuffer over memory it doesn't own
+
+static void TestByteReader()
+{
+    uint8 const data[] = { 0x01, 0x02, 0x03, 0x04, 'h', 'i', 0, 0x05, 0x06 };
+    ByteReader reader(data, sizeof(data));
+
+    CHECK(reader.size() == sizeof(data) && reader.remaining() == sizeof(data));
+    CHECK(reader.read<uint16>() == 0x0201 && reader.rpos() == 2);
+
+    // Past the end throws and keeps the position
+    bool threw = false;
+
+    try { reader.read<uint64>(); }
+    catch (ByteBufferException const&) { threw = true; }
+
+    CHECK(threw && reader.rpos() == 2);
+
+    // A slice reads its bytes on its own and the parent skips them
+    ByteReader slice = reader.Slice(2);
+    CHECK(slice.size() == 2 && slice.contents() == data + 2);
+    CHECK(slice.read<uint16>() == 0x0403 && slice.remaining() == 0);
+    CHECK(reader.rpos() == 4);
+
+    std::string text;
+    reader >> text;
+    CHECK(text == "hi" && reader.rpos() == 7);
+
+    // A slice past the end throws, an empty one at the end is fine
+    threw = false;
+
+    try { reader.Slice(3); }
+    catch (ByteBufferException const&) { threw = true; }
+
+    CHECK(threw && reader.rpos() == 7);
+
+    ByteReader rest = reader.Slice(2);
+    CHECK(rest.size() == 2 && reader.remaining() == 0);
+    CHECK(reader.Slice(0).empty() && reader.rpos() == sizeof(data));
+
+    // Checked reads share ByteBuffer's contract
+    uint16 value16 = 0;
+    uint32 value32 = 0xFFFFFFFF;
+    CHECK(!rest.TryRead(value32) && value32 == 0 && rest.rpos() == 0);
+    CHECK(rest.HasReadError() && !rest.TryRead(value16));
+    rest.ClearReadError();
+    CHECK(rest.TryRead(value16) && value16 == 0x0605);
+
+    // Views the unread part of a buffer, the buffer itself isn't advanced
+    ByteBuffer buffer;
+    buffer << uint8(9) << uint32(0xCAFEBABE);
+    buffer.read_skip<uint8>();
+
+    ByteReader unread(buffer);
+    CHECK(unread.size() == 4 && unread.read<uint32>() == 0xCAFEBABE);
+    CHECK(buffer.rpos() == 1);
+
+    buffer.read_skip<uint32>();
+    CHECK(ByteReader(buffer).empty());
+    CHECK(ByteReader().ReadCString().empty());
+}
+
+#ifndef _WIN32
+
+// Reads straight into the buffer, which grows by what arrives and keeps its read position
+static void TestSocketRead()
+{
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    socklen_t length = sizeof(address);
+    CHECK(bind(listener, (sockaddr*)&address, sizeof(address)) == 0 && listen(listener, 1) == 0);
+    CHECK(getsockname(listener, (sockaddr*)&address, &length) == 0);
+
+    TCPSocket client;
+    CHECK(client.Connect("127.0.0.1:" + std::to_string(ntohs(address.sin_port))));
+
+    int server = accept(listener, nullptr, nullptr);
+    uint8 const payload[] = { 1, 2, 3, 4 };
+    CHECK(write(server, payload, sizeof(payload)) == sizeof(payload));
+    close(server);
+    close(listener);
+
+    ByteBuffer buffer;
+    buffer << uint8(0xAA) << uint8(0xBB);
+    buffer.read_skip<uint8>();
+
+    CHECK(client.Read(&buffer, 0) == 0 && buffer.size() == 2);
+    CHECK(client.Read(&buffer, 4) == 4);
+    CHECK(buffer.size() == 6 && buffer.wpos() == 6 && buffer.rpos() == 1);
+    CHECK(!memcmp(buffer.contents() + 2, payload, 4));
+
+    // The peer closed, the failed read rolls the buffer back
+    CHECK(client.Read(&buffer, 4) == 0 && !client.IsConnected());
+    CHECK(buffer.size() == 6 && buffer.wpos() == 6 && buffer.rpos() == 1);
+}
+
+#endif
+
+// WriteBits and ReadBits batch whole bytes through an accumulator. ByteBuffer's
+// WriteBit and ReadBit still go one bit at a time, so they are the reference.
+
+static void WriteBitsReference(ByteBuffer& buffer, uint64 value, size_t bits)
+{
+    for (int32 i = int32(bits) - 1; i >= 0; --i)
+        buffer.WriteBit(uint32(value >> i) & 1);
+}
+
+static uint64 ReadBitsReference(ByteBuffer& buffer, size_t bits)
+{
+    uint64 value = 0;
+
+    for (size_t i = 0; i < bits; ++i)
+        value = (value << 1) | (buffer.ReadBit() ? 1 : 0);
+
+    return value;
+}
+
+// ReadBits returns at most 32 bits, wider fields are read in two parts
+static uint64 ReadWideBits(ByteBuffer& buffer, size_t bits)
+{
+    if (bits <= 32)
+        return buffer.ReadBits(bits);
+
+    uint64 high = buffer.ReadBits(bits - 32);
+    return (high << 32) | buffer.ReadBits(32);
+}
+
+static uint64 Mask(size_t bits)
+{
+    return bits == 64 ? ~uint64(0) : (uint64(1) << bits) - 1;
+}
+
+static bool SameContents(ByteBuffer const& left, ByteBuffer const& right)
+{
+    return left.size() == right.size() && left.wpos() == right.wpos() &&
+        (!left.size() || !memcmp(left.contents(), right.contents(), left.size()));
+}
+
+static void TestWriteBits(std::mt19937_64& random)
+{
+    for (uint32 round = 0; round < 2000; ++round)
+    {
+        ByteBuffer batched, reference;
+
+        // Unaligned start
+        uint32 offset = uint32(random() % 8);
+        for (uint32 i = 0; i < offset; ++i)
+        {
+            uint32 bit = uint32(random() & 1);
+            batched.WriteBit(bit);
+            reference.WriteBit(bit);
+        }
+
+        for (uint32 field = 0; field < 16; ++field)
+        {
+            size_t bits = size_t(random() % 64) + 1;
+            uint64 value = random();
+
+            batched.WriteBits(value, bits);
+            WriteBitsReference(reference, value, bits);
+
+            CHECK(SameContents(batched, reference));
+        }
+
+        batched.FlushBits();
+        reference.FlushBits();
+        CHECK(SameContents(batched, reference));
+    }
+
+    // Every width from every starting bit position
+    for (size_t bits = 1; bits <= 64; ++bits)
+    {
+        for (uint32 offset = 0; offset < 8; ++offset)
+        {
+            ByteBuffer batched, reference;
+            uint64 value = random();
+
+            for (uint32 i = 0; i < offset; ++i)
+            {
+                batched.WriteBit(1);
+                reference.WriteBit(1);
+            }
+
+            batched.WriteBits(value, bits);
+            WriteBitsReference(reference, value, bits);
+            batched.FlushBits();
+            reference.FlushBits();
+
+            CHECK(SameContents(batched, reference));
+        }
+    }
+}
+
+static void TestReadBits(std::mt19937_64& random)
+{
+    for (uint32 round = 0; round < 2000; ++round)
+    {
+        ByteBuffer batched, reference;
+
+        for (uint32 i = 0; i < 96; ++i)
+        {
+            uint8 byte = uint8(random());
+            batched << byte;
+            reference << byte;
+        }
+
+        uint32 offset = uint32(random() % 8);
+        for (uint32 i = 0; i < offset; ++i)
+            CHECK(batched.ReadBit() == reference.ReadBit());
+
+        // Mixes single bits into the fields so ReadBits picks up after ReadBit as well
+        for (uint32 field = 0; field < 8; ++field)
+        {
+            size_t bits = size_t(random() % 64) + 1;
+
+            CHECK(ReadWideBits(batched, bits) == ReadBitsReference(reference, bits));
+            CHECK(batched.rpos() == reference.rpos());
+
+            if (random() & 1)
+                CHECK(batched.ReadBit() == reference.ReadBit());
+        }
+    }
+
+    // Running out of data throws like the per bit reads do
+    ByteBuffer batched, reference;
+    batched << uint8(0xA5);
+    reference << uint8(0xA5);
+
+    CHECK(batched.ReadBits(3) == ReadBitsReference(reference, 3));
+
+    bool batchedThrew = false, referenceThrew = false;
+
+    try { batched.ReadBits(6); }
+    catch (ByteBufferException const&) { batchedThrew = true; }
+
+    try { ReadBitsReference(reference, 6); }
+    catch (ByteBufferException const&) { referenceThrew = true; }
+
+    CHECK(batchedThrew && referenceThrew);
+}
+
+static void TestRoundTrip(std::mt19937_64& random)
+{
+    for (uint32 round = 0; round < 2000; ++round)
+    {
+        ByteBuffer buffer;
+        uint64 values[32];
+        size_t widths[32];
+
+        uint32 offset = uint32(random() % 8);
+        for (uint32 i = 0; i < offset; ++i)
+            buffer.WriteBit(0);
+
+        for (uint32 field = 0; field < 32; ++field)
+        {
+            widths[field] = size_t(random() % 64) + 1;
+            values[field] = random();
+            buffer.WriteBits(values[field], widths[field]);
+        }
+
+        buffer.FlushBits();
+
+        for (uint32 i = 0; i < offset; ++i)
+            CHECK(!buffer.ReadBit());
+
+        for (uint32 field = 0; field < 32; ++field)
+            CHECK(ReadWideBits(buffer, widths[field]) == (values[field] & Mask(widths[field])));
+    }
+}
+
+// Inline storage: every operation must behave the same on either side of
+// ByteStorage::INLINE_SIZE, checked against a plain vector holding the same bytes
+
+static bool Holds(ByteBuffer const& buffer, std::vector<uint8> const& expected)
+{
+    return buffer.size() == expected.size() && buffer.wpos() == expected.size() &&
+        (expected.empty() || !memcmp(buffer.contents(), expected.data(), expected.size()));
+}
+
+static std::vector<uint8> Pattern(size_t size, uint8 seed)
+{
+    std::vector<uint8> bytes(size);
+
+    for (size_t i = 0; i < size; ++i)
+        bytes[i] = uint8(seed + i * 7);
+
+    return bytes;
+}
+
+static ByteBuffer Filled(std::vector<uint8> const& bytes)
+{
+    // Reserving nothing keeps a small payload inline
+    ByteBuffer buffer(0);
+
+    if (!bytes.empty())
+        buffer.append(bytes.data(), bytes.size());
+
+    return buffer;
+}
+
+static void TestInlineStorage()
+{
+    size_t const inlineSize = ByteStorage::INLINE_SIZE;
+    size_t const sizes[] = { 0, 1, inlineSize - 1, inlineSize, inlineSize + 1, 2 * inlineSize, ByteBuffer::DEFAULT_SIZE + 1 };
+
+    for (size_t size : sizes)
+    {
+        std::vector<uint8> bytes = Pattern(size, uint8(size));
+
+        ByteBuffer source = Filled(bytes);
+        CHECK(Holds(source, bytes));
+        CHECK(source.IsInline() == (size <= inlineSize));
+
+        // Copies are independent of the source
+        ByteBuffer copy(source);
+        CHECK(Holds(copy, bytes));
+        CHECK(copy.IsInline() == (size <= inlineSize));
+
+        if (size)
+        {
+            copy.contents()[0] ^= 0xFF;
+            CHECK(Holds(source, bytes));
+        }
+
+        // A heap block moves over as is, inline bytes are copied and the source is emptied
+        uint8 const* contents = source.contents();
+        ByteBuffer moved(std::move(source));
+        CHECK(Holds(moved, bytes));
+        CHECK(source.empty() && source.wpos() == 0 && source.rpos() == 0);
+        CHECK(moved.IsInline() || moved.contents() == contents);
+
+        // The source is usable again after the move
+        source << uint8(1);
+        CHECK(Holds(source, std::vector<uint8>(1, 1)));
+
+        for (size_t targetSize : sizes)
+        {
+            std::vector<uint8> targetBytes = Pattern(targetSize, uint8(targetSize + 1));
+
+            ByteBuffer copyTarget = Filled(targetBytes);
+            copyTarget = moved;
+            CHECK(Holds(copyTarget, bytes));
+            CHECK(Holds(moved, bytes));
+
+            ByteBuffer moveTarget = Filled(targetBytes);
+            ByteBuffer moveSource = Filled(bytes);
+            moveTarget = std::move(moveSource);
+            CHECK(Holds(moveTarget, bytes));
+            CHECK(moveSource.empty());
+        }
+
+        ByteBuffer& self = moved;
+        moved = self;
+        CHECK(Holds(moved, bytes));
+        moved = std::move(self);
+        CHECK(Holds(moved, bytes));
+
+        // drop shifts the tail to the front, from the heap into what inline would hold as well
+        for (size_t count : { size_t(0), size_t(1), size / 2, size, size + 1 })
+        {
+            ByteBuffer dropped = Filled(bytes);
+            dropped.drop(uint32(count));
+
+            std::vector<uint8> rest(bytes.begin() + std::min(count, size), bytes.end());
+            CHECK(Holds(dropped, rest));
+            CHECK(dropped.rpos() == 0);
+        }
+
+        // resize keeps the prefix and zeroes what it adds, growing past the inline bytes
+        for (size_t newSize : sizes)
+        {
+            ByteBuffer resized = Filled(bytes);
+            resized.resize(newSize);
+
+            std::vector<uint8> expected = bytes;
+            expected.resize(newSize);
+            CHECK(Holds(resized, expected));
+        }
+
+        // clear keeps the capacity for the packet pool
+        ByteBuffer cleared = Filled(bytes);
+        size_t capacity = cleared.capacity();
+        cleared.clear();
+        CHECK(cleared.empty() && cleared.capacity() == capacity);
+    }
+
+    // Appends that cross the inline size one byte at a time
+    ByteBuffer grown(0);
+    std::vector<uint8> expected;
+
+    for (uint32 i = 0; i < 3 * inlineSize; ++i)
+    {
+        grown << uint8(i);
+        expected.push_back(uint8(i));
+        CHECK(Holds(grown, expected));
+    }
+
+    CHECK(!grown.IsInline());
+}
+
+int main()
+{
+    std::mt19937_64 random(0x16);
+
+    TestCheckedReads();
+    TestStrings();
+    TestByteReader();
+
+#ifndef _WIN32
+    TestSocketRead();
+#endif
+
+    TestWriteBits(random);
+    TestReadBits(random);
+    TestRoundTrip(random);
+    TestInlineStorage();
+
+    return TEST_RESULT();
+}
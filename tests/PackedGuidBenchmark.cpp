@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Benchmark.h"
+#include "ByteBuffer.h"
+#include <random>
+#include <vector>
+
+// PackedGuid::Encode/Decode against the byte loops they replaced, over a stream of
+// guids shaped like the ones in update packets: small counters with a high guid
+// type byte, plus some fully random ones
+static size_t EncodeReference(uint64 guid, uint8* dest)
+{
+    size_t size = 1;
+    dest[0] = 0;
+
+    for (uint8 i = 0; guid != 0; ++i)
+    {
+        if (guid & 0xFF)
+        {
+            dest[0] |= uint8(1 << i);
+            dest[size++] = uint8(guid & 0xFF);
+        }
+
+        guid >>= 8;
+    }
+
+    return size;
+}
+
+static size_t DecodeReference(uint8 const* data, size_t length, uint64& guid)
+{
+    guid = 0;
+
+    if (!length)
+        return 0;
+
+    uint8 mask = data[0];
+    size_t pos = 1;
+
+    for (int i = 0; i < 8; ++i)
+    {
+        if (mask & (uint8(1) << i))
+        {
+            if (pos + 1 > length)
+            {
+                guid = 0;
+                return 0;
+            }
+
+            guid |= uint64(data[pos++]) << (i * 8);
+        }
+    }
+
+    return pos;
+}
+
+int main()
+{
+    std::mt19937_64 random(0x18);
+    std::vector<uint64> guids(65536);
+
+    for (uint64& guid : guids)
+    {
+        switch (random() % 4)
+        {
+            case 0: guid = random(); break;
+            case 1: guid = random() & 0xFFFF; break;
+            default: guid = (uint64(0xF130) << 48) | (random() & 0xFFFFFF); break;
+        }
+    }
+
+    std::vector<uint8> stream(guids.size() * PackedGuid::MAX_SIZE);
+    uint32 const iterations = 50;
+
+    Benchmark("Encode, byte loop, 64K guids", iterations, [&]()
+    {
+        uint8* dest = stream.data();
+
+        for (uint64 guid : guids)
+            dest += EncodeReference(guid, dest);
+
+        BENCHMARK_KEEP(dest - stream.data());
+    });
+
+    size_t streamSize = 0;
+
+    Benchmark("PackedGuid::Encode, 64K guids", iterations, [&]()
+    {
+        uint8* dest = stream.data();
+
+        for (uint64 guid : guids)
+            dest += PackedGuid::Encode(guid, dest);
+
+        streamSize = dest - stream.data();
+    });
+
+    Benchmark("Decode, byte loop, 64K guids", iterations, [&]()
+    {
+        uint64 guid;
+
+        for (size_t pos = 0; pos < streamSize; )
+        {
+            pos += DecodeReference(stream.data() + pos, streamSize - pos, guid);
+            BENCHMARK_KEEP(guid);
+        }
+    });
+
+    Benchmark("PackedGuid::Decode, 64K guids", iterations, [&]()
+    {
+        uint64 guid;
+
+        for (size_t pos = 0; pos < streamSize; )
+        {
+            pos += PackedGuid::Decode(stream.data() + pos, streamSize - pos, guid);
+            BENCHMARK_KEEP(guid);
+        }
+    });
+
+    ByteBuffer buffer(streamSize);
+    buffer.append(stream.data(), streamSize);
+
+    Benchmark("ByteBuffer::readPackGUID, 64K guids", iterations, [&]()
+    {
+        uint64 guid;
+        buffer.rpos(0);
+
+        for (size_t i = 0; i < guids.size(); ++i)
+        {
+            buffer.readPackGUID(guid);
+            BENCHMARK_KEEP(guid);
+        }
+    });
+
+    return 0;
+}
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Test.h"
+#include "ByteBuffer.h"
+#include "ByteReader.h"
+#include <random>
+
+// The table based PackedGuid codec against the byte loops it replaced
+
+static std::vector<uint8> EncodeReference(uint64 guid)
+{
+    std::vector<uint8> packed(1, 0);
+
+    for (uint8 i = 0; guid != 0; ++i)
+    {
+        if (guid & 0xFF)
+        {
+            packed[0] |= uint8(1 << i);
+            packed.push_back(uint8(guid & 0xFF));
+        }
+
+        guid >>= 8;
+    }
+
+    return packed;
+}
+
+// Bytes consumed, 0 if the data is truncated
+static size_t DecodeReference(uint8 const* data, size_t length, uint64& guid)
+{
+    guid = 0;
+
+    if (!length)
+        return 0;
+
+    uint8 mask = data[0];
+    size_t pos = 1;
+
+    for (int i = 0; i < 8; ++i)
+    {
+        if (mask & (uint8(1) << i))
+        {
+            if (pos + 1 > length)
+            {
+                guid = 0;
+                return 0;
+            }
+
+            guid |= uint64(data[pos++]) << (i * 8);
+        }
+    }
+
+    return pos;
+}
+
+static void CheckGuid(uint64 guid)
+{
+    std::vector<uint8> expected = EncodeReference(guid);
+
+    // Every way of writing one
+    uint8 encoded[PackedGuid::MAX_SIZE];
+    CHECK(PackedGuid::Encode(guid, encoded) == expected.size());
+    CHECK(!memcmp(encoded, expected.data(), expected.size()));
+    CHECK(PackedGuid::GetPayloadSize(expected[0]) + 1 == expected.size());
+
+    PackedGuid packed(guid);
+    CHECK(packed.size() == expected.size());
+    CHECK(!memcmp(packed.contents(), expected.data(), expected.size()));
+
+    ByteBuffer buffer(0);
+    buffer.appendPackGUID(guid);
+    buffer << ObjectGuid(guid).WriteAsPacked();
+    CHECK(buffer.size() == 2 * expected.size());
+    CHECK(!memcmp(buffer.contents(), expected.data(), expected.size()));
+    CHECK(!memcmp(buffer.contents() + expected.size(), expected.data(), expected.size()));
+
+    // Exact length and with bytes to spare, which takes the fixed size copy
+    uint64 decoded = ~guid;
+    CHECK(PackedGuid::Decode(expected.data(), expected.size(), decoded) == expected.size());
+    CHECK(decoded == guid);
+
+    std::vector<uint8> padded = expected;
+    padded.resize(expected.size() + PackedGuid::MAX_SIZE, 0xEE);
+    decoded = ~guid;
+    CHECK(PackedGuid::Decode(padded.data(), padded.size(), decoded) == expected.size());
+    CHECK(decoded == guid);
+
+    // Every way of reading one
+    uint64 first = 0, second = 0;
+    buffer.readPackGUID(first);
+    CHECK(buffer.TryReadPackGUID(second));
+    CHECK(first == guid && second == guid);
+    CHECK(buffer.rpos() == buffer.size() && !buffer.HasReadError());
+
+    buffer.rpos(0);
+    ObjectGuid object;
+    buffer >> object.ReadAsPacked();
+    CHECK(object.GetRawValue() == guid);
+
+    buffer.rpos(0);
+    ByteReader reader(buffer);
+    first = second = 0;
+    reader.readPackGUID(first);
+    CHECK(reader.TryReadPackGUID(second));
+    CHECK(first == guid && second == guid);
+    CHECK(reader.rpos() == reader.size() && !reader.HasReadError());
+
+    // Every truncation fails without consuming anything
+    for (size_t length = 0; length < expected.size(); ++length)
+    {
+        decoded = ~guid;
+        CHECK(!PackedGuid::Decode(expected.data(), length, decoded));
+        CHECK(!decoded);
+
+        // Appending nothing throws
+        ByteBuffer truncated(0);
+        if (length)
+            truncated.append(expected.data(), length);
+
+        bool threw = false;
+        try { truncated.readPackGUID(decoded); }
+        catch (ByteBufferException const&) { threw = true; }
+        CHECK(threw);
+
+        decoded = ~guid;
+        CHECK(!truncated.TryReadPackGUID(decoded));
+        CHECK(!decoded && truncated.rpos() == 0 && truncated.HasReadError());
+
+        // The error is sticky, even once the rest of the guid arrives
+        truncated.append(expected.data() + length, expected.size() - length);
+        CHECK(!truncated.TryReadPackGUID(decoded));
+        truncated.ClearReadError();
+        CHECK(truncated.TryReadPackGUID(decoded) && decoded == guid);
+
+        ByteReader truncatedReader(expected.data(), length);
+        decoded = ~guid;
+        CHECK(!truncatedReader.TryReadPackGUID(decoded));
+        CHECK(!decoded && truncatedReader.rpos() == 0 && truncatedReader.HasReadError());
+    }
+}
+
+int main()
+{
+    std::mt19937_64 random(0x18);
+
+    CheckGuid(0);
+    CheckGuid(~uint64(0));
+
+    // A single byte set, the lowest and highest values in every position
+    for (uint32 i = 0; i < 8; ++i)
+    {
+        CheckGuid(uint64(0x01) << (i * 8));
+        CheckGuid(uint64(0xFF) << (i * 8));
+    }
+
+    // Every mask with random non-zero bytes
+    for (uint32 mask = 0; mask < 256; ++mask)
+    {
+        for (uint32 round = 0; round < 16; ++round)
+        {
+            uint64 guid = 0;
+
+            for (uint32 i = 0; i < 8; ++i)
+                if (mask & (1 << i))
+                    guid |= uint64(random() % 255 + 1) << (i * 8);
+
+            CheckGuid(guid);
+        }
+    }
+
+    // Arbitrary input decodes the same as with the byte loop
+    for (uint32 round = 0; round < 100000; ++round)
+    {
+        uint8 data[16];
+        size_t length = size_t(random() % (sizeof(data) + 1));
+
+        for (size_t i = 0; i < length; ++i)
+            data[i] = uint8(random());
+
+        uint64 expected = 0, decoded = 0;
+        CHECK(PackedGuid::Decode(data, length, decoded) == DecodeReference(data, length, expected));
+        CHECK(decoded == expected);
+    }
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,478 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Test.h"
+#include "WorldPacket.h"
+#include "WorldPacketSchemas.h"
+#include "CharacterList.h"
+#include <random>
+
+// The schemas replaced reads and writes spelled out field by field, those are
+// kept here as the reference the schemas have to match byte for byte
+
+struct Inner
+{
+    uint16 A;
+    uint8 B;
+};
+
+typedef PacketSchema<
+    SCHEMA_FIELD(Inner, A),
+    SCHEMA_FIELD(Inner, B)
+> InnerSchema;
+
+struct Sample
+{
+    uint32 Id;
+    bool Flag;
+    std::string Name;
+    uint8 Raw[3];
+    Inner Single;
+    Inner Many[4];
+    std::string Note;
+    float Scale;
+};
+
+typedef PacketSchema<
+    SCHEMA_FIELD(Sample, Id),
+    SCHEMA_FIELD(Sample, Flag),
+    SCHEMA_STRING(Sample, Name),
+    SCHEMA_BYTES(Sample, Raw),
+    SchemaPad<2>,
+    SCHEMA_NESTED(Sample, Single, InnerSchema),
+    SCHEMA_ARRAY(Sample, Many, InnerSchema),
+    SCHEMA_STRING(Sample, Note),
+    SCHEMA_FIELD(Sample, Scale)
+> SampleSchema;
+
+static void WriteSampleReference(ByteBuffer& buffer, Sample const& sample)
+{
+    buffer << sample.Id << uint8(sample.Flag) << sample.Name;
+    buffer.append(sample.Raw, sizeof(sample.Raw));
+    buffer << uint16(0);
+    buffer << sample.Single.A << sample.Single.B;
+
+    for (Inner const& inner : sample.Many)
+        buffer << inner.A << inner.B;
+
+    buffer << sample.Note << sample.Scale;
+}
+
+static bool SameSample(Sample const& left, Sample const& right)
+{
+    if (left.Id != right.Id || left.Flag != right.Flag || left.Name != right.Name || left.Note != right.Note || left.Scale != right.Scale)
+        return false;
+
+    if (memcmp(left.Raw, right.Raw, sizeof(left.Raw)) || left.Single.A != right.Single.A || left.Single.B != right.Single.B)
+        return false;
+
+    for (size_t i = 0; i < 4; ++i)
+    {
+        if (left.Many[i].A != right.Many[i].A || left.Many[i].B != right.Many[i].B)
+            return false;
+    }
+
+    return true;
+}
+
+static std::string RandomString(std::mt19937& random)
+{
+    std::string value(random() % 12, 'a');
+
+    for (char& c : value)
+        c = char('a' + random() % 26);
+
+    return value;
+}
+
+static Sample RandomSample(std::mt19937& random)
+{
+    Sample sample;
+    sample.Id = random();
+    sample.Flag = random() & 1;
+    sample.Name = RandomString(random);
+
+    for (uint8& byte : sample.Raw)
+        byte = uint8(random());
+
+    sample.Single.A = uint16(random());
+    sample.Single.B = uint8(random());
+
+    for (Inner& inner : sample.Many)
+    {
+        inner.A = uint16(random());
+        inner.B = uint8(random());
+    }
+
+    sample.Note = RandomString(random);
+    sample.Scale = float(random() % 1000) / 8;
+    return sample;
+}
+
+static bool SameBytes(ByteBuffer const& left, ByteBuffer const& right)
+{
+    return left.size() == right.size() && (!left.size() || !memcmp(left.contents(), right.contents(), left.size()));
+}
+
+static void TestRoundTrip(std::mt19937& random)
+{
+    CHECK(InnerSchema::IsFixed && InnerSchema::MinSize == 3);
+    CHECK(!SampleSchema::IsFixed && SampleSchema::MinSize == 4 + 1 + 3 + 2 + 3 + 4 * 3 + 4);
+
+    for (uint32 round = 0; round < 500; ++round)
+    {
+        Sample sample = RandomSample(random);
+
+        ByteBuffer written, reference;
+        written << uint8(0x7F);
+        reference << uint8(0x7F);
+
+        SampleSchema::Write(written, sample);
+        WriteSampleReference(reference, sample);
+        CHECK(SameBytes(written, reference));
+
+        // Reads pick up at the read position and move it past what they consumed
+        Sample read;
+        written.read_skip<uint8>();
+        CHECK(SampleSchema::Read(written, read) && SameSample(read, sample));
+        CHECK(written.rpos() == written.size());
+
+        ByteReader reader(written.contents() + 1, written.size() - 1);
+        Sample viewed;
+        CHECK(SampleSchema::Read(reader, viewed) && SameSample(viewed, sample));
+        CHECK(reader.rpos() == reader.size());
+
+        // Every truncation fails and leaves the read position alone
+        for (size_t length = 0; length + 1 < written.size(); ++length)
+        {
+            ByteBuffer truncated;
+            truncated << uint8(0x7F);
+
+            if (length)
+                truncated.append(written.contents() + 1, length);
+
+            truncated.read_skip<uint8>();
+            CHECK(!SampleSchema::Read(truncated, read));
+            CHECK(truncated.rpos() == 1);
+
+            ByteReader truncatedReader(written.contents() + 1, length);
+            CHECK(!SampleSchema::Read(truncatedReader, read));
+            CHECK(truncatedReader.rpos() == 0);
+        }
+    }
+
+    // Any non-zero byte reads as true
+    ByteBuffer flag;
+    flag << uint16(0x0102) << uint8(0x80);
+
+    struct Flags { uint16 Value; bool Set; } flags;
+    typedef PacketSchema<SCHEMA_FIELD(Flags, Value), SCHEMA_FIELD(Flags, Set)> FlagsSchema;
+    CHECK(FlagsSchema::Read(flag, flags) && flags.Value == 0x0102 && flags.Set);
+}
+
+// Fixed size field that refuses a zero value, to check a rejection reaches the caller
+template <typename Class, uint32 Class::*Member>
+struct NonZeroField
+{
+    static const bool IsFixed = true;
+    static const size_t Size = sizeof(uint32);
+
+    template <typename Owner> static bool Read(uint8 const*& data, uint8 const* end, Owner& owner)
+    {
+        return SchemaField<Class, uint32, Member>::Read(data, end, owner) && owner.*Member;
+    }
+
+    template <typename Owner> static size_t GetSize(Owner const& /*owner*/) { return Size; }
+
+    template <typename Owner> static void Write(uint8*& data, Owner const& owner)
+    {
+        SchemaField<Class, uint32, Member>::Write(data, owner);
+    }
+};
+
+struct Slot
+{
+    uint8 Index;
+    uint32 Item;
+};
+
+typedef PacketSchema<
+    SCHEMA_FIELD(Slot, Index),
+    NonZeroField<Slot, &Slot::Item>
+> SlotSchema;
+
+struct Slots
+{
+    std::string Owner;
+    Slot Entries[3];
+    uint8 Trailer;
+};
+
+typedef PacketSchema<
+    SCHEMA_STRING(Slots, Owner),
+    SCHEMA_ARRAY(Slots, Entries, SlotSchema),
+    SCHEMA_FIELD(Slots, Trailer)
+> SlotsSchema;
+
+static void TestRejectedField()
+{
+    for (size_t rejected = 0; rejected < 4; ++rejected)
+    {
+        ByteBuffer buffer;
+        buffer << std::string("owner");
+
+        for (size_t i = 0; i < 3; ++i)
+            buffer << uint8(i) << uint32(i == rejected ? 0 : 100 + i);
+
+        buffer << uint8(0xEE);
+
+        // A rejected element fails the whole read, wherever it sits in the array
+        Slots slots;
+        CHECK(SlotsSchema::Read(buffer, slots) == (rejected == 3));
+        CHECK(buffer.rpos() == (rejected == 3 ? buffer.size() : 0));
+
+        Slot slot;
+        ByteReader reader(buffer.contents() + 6, SlotSchema::MinSize);
+        CHECK(SlotSchema::Read(reader, slot) == (rejected != 0));
+    }
+}
+
+// SMSG_CHAR_ENUM, the way CharacterList::Populate read it before the schema
+
+static void ReadCharacterReference(ByteBuffer& packet, Character& character)
+{
+    packet >> character.Guid;
+    packet >> character.Name;
+    packet.read((uint8*)&character.Race, 1);
+    packet.read((uint8*)&character.Class, 1);
+    packet.read((uint8*)&character.Gender, 1);
+    packet >> character.Display.Skin;
+    packet >> character.Display.Face;
+    packet >> character.Display.HairStyle;
+    packet >> character.Display.HairColor;
+    packet >> character.Display.FacialHair;
+    packet >> character.Level;
+    packet >> character.AreaId;
+    packet >> character.MapId;
+    packet >> character.Position.X;
+    packet >> character.Position.Y;
+    packet >> character.Position.Z;
+    packet >> character.GuildId;
+    packet >> character.Flags;
+    packet >> character.CustomizationFlags;
+    packet >> character.IsFirstLogin;
+    packet >> character.Pet.DisplayId;
+    packet >> character.Pet.Level;
+    packet >> character.Pet.Family;
+
+    for (uint8 j = 0; j < 19; j++)
+    {
+        packet >> character.Items[j].DisplayId;
+        packet >> character.Items[j].InventoryType;
+        packet >> character.Items[j].EnchantAuraId;
+    }
+
+    for (uint8 j = 0; j < 4; j++)
+    {
+        packet >> character.Bags[j].DisplayId;
+        packet >> character.Bags[j].InventoryType;
+        packet >> character.Bags[j].EnchantId;
+    }
+}
+
+static void WriteRandomCharacter(ByteBuffer& packet, std::mt19937& random, std::string const& name)
+{
+    packet << uint64(random()) << name;
+
+    // Race, class, gender and the five display bytes
+    for (uint32 i = 0; i < 8; ++i)
+        packet << uint8(random());
+
+    packet << uint8(random()) << uint32(random()) << uint32(random());
+    packet << float(random() % 1000) << float(random() % 1000) << float(random() % 1000);
+    packet << uint32(random()) << uint32(random()) << uint32(random()) << uint8(random() % 3);
+    packet << uint32(random()) << uint32(random()) << uint32(random());
+
+    for (uint32 i = 0; i < 19 + 4; ++i)
+        packet << uint32(random()) << uint8(random()) << uint32(random());
+}
+
+static bool SameCharacter(Character const& left, Character const& right)
+{
+    bool same = left.Guid == right.Guid && left.Name == right.Name && left.Race == right.Race &&
+        left.Class == right.Class && left.Gender == right.Gender && left.Level == right.Level &&
+        left.AreaId == right.AreaId && left.MapId == right.MapId && left.GuildId == right.GuildId &&
+        left.Flags == right.Flags && left.CustomizationFlags == right.CustomizationFlags &&
+        left.IsFirstLogin == right.IsFirstLogin;
+
+    same = same && !memcmp(&left.Display, &right.Display, sizeof(left.Display)) &&
+        left.Position.X == right.Position.X && left.Position.Y == right.Position.Y && left.Position.Z == right.Position.Z &&
+        left.Pet.DisplayId == right.Pet.DisplayId && left.Pet.Level == right.Pet.Level && left.Pet.Family == right.Pet.Family;
+
+    for (size_t i = 0; same && i < 19; ++i)
+    {
+        same = left.Items[i].DisplayId == right.Items[i].DisplayId && left.Items[i].InventoryType == right.Items[i].InventoryType &&
+            left.Items[i].EnchantAuraId == right.Items[i].EnchantAuraId;
+    }
+
+    for (size_t i = 0; same && i < 4; ++i)
+    {
+        same = left.Bags[i].DisplayId == right.Bags[i].DisplayId && left.Bags[i].InventoryType == right.Bags[i].InventoryType &&
+            left.Bags[i].EnchantId == right.Bags[i].EnchantId;
+    }
+
+    return same;
+}
+
+static void TestCharacterList(std::mt19937& random)
+{
+    std::string const names[] = { "Alpha", "", "Charlie" };
+
+    for (uint32 round = 0; round < 50; ++round)
+    {
+        WorldPacket packet(SMSG_CHAR_ENUM);
+
+        for (std::string const& name : names)
+            WriteRandomCharacter(packet, random, name);
+
+        ByteBuffer reference(packet);
+        Character expected[3];
+
+        for (Character& character : expected)
+            ReadCharacterReference(reference, character);
+
+        CHECK(reference.rpos() == reference.size());
+
+        CharacterList list;
+        CHECK(list.Populate(3, packet));
+        CHECK(packet.rpos() == packet.size());
+
+        for (Character const& character : expected)
+        {
+            Character const* parsed = list.GetCharacterByName(character.Name);
+            CHECK(parsed && SameCharacter(*parsed, character));
+        }
+
+        // A list cut anywhere is reported, the old reads threw
+        for (size_t length = 0; length < packet.size(); length += 7)
+        {
+            WorldPacket truncated(SMSG_CHAR_ENUM);
+
+            if (length)
+                truncated.append(packet.contents(), length);
+
+            CharacterList partial;
+            CHECK(!partial.Populate(3, truncated));
+        }
+    }
+}
+
+// SMSG_AUTH_CHALLENGE and the header of CMSG_AUTH_SESSION, as AuthHandler read and wrote them
+
+static void TestAuthPackets(std::mt19937& random)
+{
+    for (uint32 round = 0; round < 200; ++round)
+    {
+        WorldPacket packet(SMSG_AUTH_CHALLENGE);
+
+        for (uint32 i = 0; i < 40; ++i)
+            packet << uint8(random());
+
+        ByteBuffer reference(packet);
+        uint32 unk, serverSeed;
+        uint8 encryptionSeed[2][16];
+        reference >> unk >> serverSeed;
+        reference.read(encryptionSeed[0], 16);
+        reference.read(encryptionSeed[1], 16);
+
+        AuthChallenge challenge;
+        CHECK(AuthChallengeSchema::Read(packet, challenge));
+        CHECK(challenge.Unk == unk && challenge.ServerSeed == serverSeed);
+        CHECK(!memcmp(challenge.EncryptionSeed, encryptionSeed, sizeof(encryptionSeed)));
+
+        WorldPacket truncated(SMSG_AUTH_CHALLENGE);
+        truncated.append(packet.contents(), 39);
+        CHECK(!AuthChallengeSchema::Read(truncated, challenge) && truncated.rpos() == 0);
+
+        AuthSessionHeader header;
+        header.Build = random();
+        header.Account = RandomString(random);
+        header.ClientSeed = random();
+        header.RealmId = random();
+
+        for (uint8& byte : header.Digest)
+            byte = uint8(random());
+
+        WorldPacket written(CMSG_AUTH_SESSION);
+        AuthSessionHeaderSchema::Write(written, header);
+
+        WorldPacket expected(CMSG_AUTH_SESSION);
+        expected << uint32(header.Build);
+        expected << uint32(0);
+        expected << header.Account;
+        expected << uint32(0);
+        expected << header.ClientSeed;
+        expected << uint32(0);
+        expected << uint32(0);
+        expected << uint32(header.RealmId);
+        expected << uint64(0);
+        expected.append(header.Digest, 20);
+
+        CHECK(SameBytes(written, expected));
+    }
+}
+
+// The fixed part of SMSG_MESSAGECHAT, as ChatHandler read it
+
+static void TestChatHeader(std::mt19937& random)
+{
+    for (uint32 round = 0; round < 200; ++round)
+    {
+        WorldPacket packet(SMSG_MESSAGECHAT);
+        packet << uint8(random()) << uint32(random()) << uint64(random()) << uint32(random()) << uint32(random());
+
+        ByteBuffer reference(packet);
+        ChatMessage expected;
+        expected.Type = reference.read<ChatType>();
+        expected.Language = reference.read<Languages>();
+        reference >> expected.SenderGUID;
+        reference >> expected.Flags;
+
+        ChatMessage message;
+        CHECK(ChatMessageHeaderSchema::Read(packet, message));
+        CHECK(message.Type == expected.Type && message.Language == expected.Language);
+        CHECK(message.SenderGUID == expected.SenderGUID && message.Flags == expected.Flags);
+        CHECK(packet.rpos() == reference.rpos());
+
+        WorldPacket truncated(SMSG_MESSAGECHAT);
+        truncated.append(packet.contents(), 16);
+        CHECK(!ChatMessageHeaderSchema::Read(truncated, message) && truncated.rpos() == 0);
+    }
+}
+
+int main()
+{
+    std::mt19937 random(0x19);
+
+    TestRoundTrip(random);
+    TestRejectedField();
+    TestCharacterList(random);
+    TestAuthPackets(random);
+    TestChatHeader(random);
+
+    return TEST_RESULT();
+}
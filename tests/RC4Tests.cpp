@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Test.h"
+#include "RC4.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+// Keystream of the 40, 128 and 256 bit keys from RFC 6229, 16 bytes at each offset.
+// The last offsets sit on both sides of the end of the first KEYSTREAM_SIZE block.
+struct KnownAnswer
+{
+    uint32 offset;
+    uint8 keystream[16];
+};
+
+struct KnownKey
+{
+    int32 length;
+    uint8 key[32];
+    KnownAnswer answers[18];
+};
+
+static KnownKey const KnownKeys[] =
+{
+    // 40 bit key
+    {
+        5, { 0x01, 0x02, 0x03, 0x04, 0x05 },
+        {
+            {    0, { 0xB2, 0x39, 0x63, 0x05, 0xF0, 0x3D, 0xC0, 0x27, 0xCC, 0xC3, 0x52, 0x4A, 0x0A, 0x11, 0x18, 0xA8 } },
+            {   16, { 0x69, 0x82, 0x94, 0x4F, 0x18, 0xFC, 0x82, 0xD5, 0x89, 0xC4, 0x03, 0xA4, 0x7A, 0x0D, 0x09, 0x19 } },
+            {  240, { 0x28, 0xCB, 0x11, 0x32, 0xC9, 0x6C, 0xE2, 0x86, 0x42, 0x1D, 0xCA, 0xAD, 0xB8, 0xB6, 0x9E, 0xAE } },
+            {  256, { 0x1C, 0xFC, 0xF6, 0x2B, 0x03, 0xED, 0xDB, 0x64, 0x1D, 0x77, 0xDF, 0xCF, 0x7F, 0x8D, 0x8C, 0x93 } },
+            {  496, { 0x42, 0xB7, 0xD0, 0xCD, 0xD9, 0x18, 0xA8, 0xA3, 0x3D, 0xD5, 0x17, 0x81, 0xC8, 0x1F, 0x40, 0x41 } },
+            {  512, { 0x64, 0x59, 0x84, 0x44, 0x32, 0xA7, 0xDA, 0x92, 0x3C, 0xFB, 0x3E, 0xB4, 0x98, 0x06, 0x61, 0xF6 } },
+            {  752, { 0xEC, 0x10, 0x32, 0x7B, 0xDE, 0x2B, 0xEE, 0xFD, 0x18, 0xF9, 0x27, 0x76, 0x80, 0x45, 0x7E, 0x22 } },
+            {  768, { 0xEB, 0x62, 0x63, 0x8D, 0x4F, 0x0B, 0xA1, 0xFE, 0x9F, 0xCA, 0x20, 0xE0, 0x5B, 0xF8, 0xFF, 0x2B } },
+            { 1008, { 0x45, 0x12, 0x90, 0x48, 0xE6, 0xA0, 0xED, 0x0B, 0x56, 0xB4, 0x90, 0x33, 0x8F, 0x07, 0x8D, 0xA5 } },
+            { 1024, { 0x30, 0xAB, 0xBC, 0xC7, 0xC2, 0x0B, 0x01, 0x60, 0x9F, 0x23, 0xEE, 0x2D, 0x5F, 0x6B, 0xB7, 0xDF } },
+            { 1520, { 0x32, 0x94, 0xF7, 0x44, 0xD8, 0xF9, 0x79, 0x05, 0x07, 0xE7, 0x0F, 0x62, 0xE5, 0xBB, 0xCE, 0xEA } },
+            { 1536, { 0xD8, 0x72, 0x9D, 0xB4, 0x18, 0x82, 0x25, 0x9B, 0xEE, 0x4F, 0x82, 0x53, 0x25, 0xF5, 0xA1, 0x30 } },
+            { 2032, { 0x1E, 0xB1, 0x4A, 0x0C, 0x13, 0xB3, 0xBF, 0x47, 0xFA, 0x2A, 0x0B, 0xA9, 0x3A, 0xD4, 0x5B, 0x8B } },
+            { 2048, { 0xCC, 0x58, 0x2F, 0x8B, 0xA9, 0xF2, 0x65, 0xE2, 0xB1, 0xBE, 0x91, 0x12, 0xE9, 0x75, 0xD2, 0xD7 } },
+            { 3056, { 0xF2, 0xE3, 0x0F, 0x9B, 0xD1, 0x02, 0xEC, 0xBF, 0x75, 0xAA, 0xAD, 0xE9, 0xBC, 0x35, 0xC4, 0x3C } },
+            { 3072, { 0xEC, 0x0E, 0x11, 0xC4, 0x79, 0xDC, 0x32, 0x9D, 0xC8, 0xDA, 0x79, 0x68, 0xFE, 0x96, 0x56, 0x81 } },
+            { 4080, { 0x06, 0x83, 0x26, 0xA2, 0x11, 0x84, 0x16, 0xD2, 0x1F, 0x9D, 0x04, 0xB2, 0xCD, 0x1C, 0xA0, 0x50 } },
+            { 4096, { 0xFF, 0x25, 0xB5, 0x89, 0x95, 0x99, 0x67, 0x07, 0xE5, 0x1F, 0xBD, 0xF0, 0x8B, 0x34, 0xD8, 0x75 } },
+        }
+    },
+    // 128 bit key
+    {
+        16, { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10 },
+        {
+            {    0, { 0x9A, 0xC7, 0xCC, 0x9A, 0x60, 0x9D, 0x1E, 0xF7, 0xB2, 0x93, 0x28, 0x99, 0xCD, 0xE4, 0x1B, 0x97 } },
+            {   16, { 0x52, 0x48, 0xC4, 0x95, 0x90, 0x14, 0x12, 0x6A, 0x6E, 0x8A, 0x84, 0xF1, 0x1D, 0x1A, 0x9E, 0x1C } },
+            {  240, { 0x06, 0x59, 0x02, 0xE4, 0xB6, 0x20, 0xF6, 0xCC, 0x36, 0xC8, 0x58, 0x9F, 0x66, 0x43, 0x2F, 0x2B } },
+            {  256, { 0xD3, 0x9D, 0x56, 0x6B, 0xC6, 0xBC, 0xE3, 0x01, 0x07, 0x68, 0x15, 0x15, 0x49, 0xF3, 0x87, 0x3F } },
+            {  496, { 0xB6, 0xD1, 0xE6, 0xC4, 0xA5, 0xE4, 0x77, 0x1C, 0xAD, 0x79, 0x53, 0x8D, 0xF2, 0x95, 0xFB, 0x11 } },
+            {  512, { 0xC6, 0x8C, 0x1D, 0x5C, 0x55, 0x9A, 0x97, 0x41, 0x23, 0xDF, 0x1D, 0xBC, 0x52, 0xA4, 0x3B, 0x89 } },
+            {  752, { 0xC5, 0xEC, 0xF8, 0x8D, 0xE8, 0x97, 0xFD, 0x57, 0xFE, 0xD3, 0x01, 0x70, 0x1B, 0x82, 0xA2, 0x59 } },
+            {  768, { 0xEC, 0xCB, 0xE1, 0x3D, 0xE1, 0xFC, 0xC9, 0x1C, 0x11, 0xA0, 0xB2, 0x6C, 0x0B, 0xC8, 0xFA, 0x4D } },
+            { 1008, { 0xE7, 0xA7, 0x25, 0x74, 0xF8, 0x78, 0x2A, 0xE2, 0x6A, 0xAB, 0xCF, 0x9E, 0xBC, 0xD6, 0x60, 0x65 } },
+            { 1024, { 0xBD, 0xF0, 0x32, 0x4E, 0x60, 0x83, 0xDC, 0xC6, 0xD3, 0xCE, 0xDD, 0x3C, 0xA8, 0xC5, 0x3C, 0x16 } },
+            { 1520, { 0xB4, 0x01, 0x10, 0xC4, 0x19, 0x0B, 0x56, 0x22, 0xA9, 0x61, 0x16, 0xB0, 0x01, 0x7E, 0xD2, 0x97 } },
+            { 1536, { 0xFF, 0xA0, 0xB5, 0x14, 0x64, 0x7E, 0xC0, 0x4F, 0x63, 0x06, 0xB8, 0x92, 0xAE, 0x66, 0x11, 0x81 } },
+            { 2032, { 0xD0, 0x3D, 0x1B, 0xC0, 0x3C, 0xD3, 0x3D, 0x70, 0xDF, 0xF9, 0xFA, 0x5D, 0x71, 0x96, 0x3E, 0xBD } },
+            { 2048, { 0x8A, 0x44, 0x12, 0x64, 0x11, 0xEA, 0xA7, 0x8B, 0xD5, 0x1E, 0x8D, 0x87, 0xA8, 0x87, 0x9B, 0xF5 } },
+            { 3056, { 0xFA, 0xBE, 0xB7, 0x60, 0x28, 0xAD, 0xE2, 0xD0, 0xE4, 0x87, 0x22, 0xE4, 0x6C, 0x46, 0x15, 0xA3 } },
+            { 3072, { 0xC0, 0x5D, 0x88, 0xAB, 0xD5, 0x03, 0x57, 0xF9, 0x35, 0xA6, 0x3C, 0x59, 0xEE, 0x53, 0x76, 0x23 } },
+            { 4080, { 0xFF, 0x38, 0x26, 0x5C, 0x16, 0x42, 0xC1, 0xAB, 0xE8, 0xD3, 0xC2, 0xFE, 0x5E, 0x57, 0x2B, 0xF8 } },
+            { 4096, { 0xA3, 0x6A, 0x4C, 0x30, 0x1A, 0xE8, 0xAC, 0x13, 0x61, 0x0C, 0xCB, 0xC1, 0x22, 0x56, 0xCA, 0xCC } },
+        }
+    },
+    // 256 bit key
+    {
+        32, { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20 },
+        {
+            {    0, { 0xEA, 0xA6, 0xBD, 0x25, 0x88, 0x0B, 0xF9, 0x3D, 0x3F, 0x5D, 0x1E, 0x4C, 0xA2, 0x61, 0x1D, 0x91 } },
+            {   16, { 0xCF, 0xA4, 0x5C, 0x9F, 0x7E, 0x71, 0x4B, 0x54, 0xBD, 0xFA, 0x80, 0x02, 0x7C, 0xB1, 0x43, 0x80 } },
+            {  240, { 0x11, 0x4A, 0xE3, 0x44, 0xDE, 0xD7, 0x1B, 0x35, 0xF2, 0xE6, 0x0F, 0xEB, 0xAD, 0x72, 0x7F, 0xD8 } },
+            {  256, { 0x02, 0xE1, 0xE7, 0x05, 0x6B, 0x0F, 0x62, 0x39, 0x00, 0x49, 0x64, 0x22, 0x94, 0x3E, 0x97, 0xB6 } },
+            {  496, { 0x91, 0xCB, 0x93, 0xC7, 0x87, 0x96, 0x4E, 0x10, 0xD9, 0x52, 0x7D, 0x99, 0x9C, 0x6F, 0x93, 0x6B } },
+            {  512, { 0x49, 0xB1, 0x8B, 0x42, 0xF8, 0xE8, 0x36, 0x7C, 0xBE, 0xB5, 0xEF, 0x10, 0x4B, 0xA1, 0xC7, 0xCD } },
+            {  752, { 0x87, 0x08, 0x4B, 0x3B, 0xA7, 0x00, 0xBA, 0xDE, 0x95, 0x56, 0x10, 0x67, 0x27, 0x45, 0xB3, 0x74 } },
+            {  768, { 0xE7, 0xA7, 0xB9, 0xE9, 0xEC, 0x54, 0x0D, 0x5F, 0xF4, 0x3B, 0xDB, 0x12, 0x79, 0x2D, 0x1B, 0x35 } },
+            { 1008, { 0xC7, 0x99, 0xB5, 0x96, 0x73, 0x8F, 0x6B, 0x01, 0x8C, 0x76, 0xC7, 0x4B, 0x17, 0x59, 0xBD, 0x90 } },
+            { 1024, { 0x7F, 0xEC, 0x5B, 0xFD, 0x9F, 0x9B, 0x89, 0xCE, 0x65, 0x48, 0x30, 0x90, 0x92, 0xD7, 0xE9, 0x58 } },
+            { 1520, { 0x40, 0xF2, 0x50, 0xB2, 0x6D, 0x1F, 0x09, 0x6A, 0x4A, 0xFD, 0x4C, 0x34, 0x0A, 0x58, 0x88, 0x15 } },
+            { 1536, { 0x3E, 0x34, 0x13, 0x5C, 0x79, 0xDB, 0x01, 0x02, 0x00, 0x76, 0x76, 0x51, 0xCF, 0x26, 0x30, 0x73 } },
+            { 2032, { 0xF6, 0x56, 0xAB, 0xCC, 0xF8, 0x8D, 0xD8, 0x27, 0x02, 0x7B, 0x2C, 0xE9, 0x17, 0xD4, 0x64, 0xEC } },
+            { 2048, { 0x18, 0xB6, 0x25, 0x03, 0xBF, 0xBC, 0x07, 0x7F, 0xBA, 0xBB, 0x98, 0xF2, 0x0D, 0x98, 0xAB, 0x34 } },
+            { 3056, { 0x8A, 0xED, 0x95, 0xEE, 0x5B, 0x0D, 0xCB, 0xFB, 0xEF, 0x4E, 0xB2, 0x1D, 0x3A, 0x3F, 0x52, 0xF9 } },
+            { 3072, { 0x62, 0x5A, 0x1A, 0xB0, 0x0E, 0xE3, 0x9A, 0x53, 0x27, 0x34, 0x6B, 0xDD, 0xB0, 0x1A, 0x9C, 0x18 } },
+            { 4080, { 0xA1, 0x3A, 0x7C, 0x79, 0xC7, 0xE1, 0x19, 0xB5, 0xAB, 0x02, 0x96, 0xAB, 0x28, 0xC3, 0x00, 0xB9 } },
+            { 4096, { 0xF3, 0xE4, 0xC0, 0xA2, 0xE0, 0x2D, 0x1D, 0x01, 0xF7, 0xF0, 0xA7, 0x46, 0x18, 0xAF, 0x2B, 0x48 } },
+        }
+    },
+};
+
+// Textbook RC4, one byte at a time
+class ReferenceRC4
+{
+    public:
+        ReferenceRC4(uint8 const* key, size_t length) : x_(0), y_(0)
+        {
+            for (uint32 i = 0; i < 256; ++i)
+                state_[i] = uint8(i);
+
+            uint8 j = 0;
+
+            for (uint32 i = 0; i < 256; ++i)
+            {
+                j = uint8(j + state_[i] + key[i % length]);
+                std::swap(state_[i], state_[j]);
+            }
+        }
+
+        uint8 Next()
+        {
+            x_ = uint8(x_ + 1);
+            y_ = uint8(y_ + state_[x_]);
+            std::swap(state_[x_], state_[y_]);
+            return state_[uint8(state_[x_] + state_[y_])];
+        }
+
+    private:
+        uint8 state_[256];
+        uint8 x_;
+        uint8 y_;
+};
+
+static std::vector<uint8> Keystream(RC4& cipher, size_t length)
+{
+    std::vector<uint8> data(length, 0);
+    cipher.Update(data.data(), int32(length));
+    return data;
+}
+
+static void TestKnownAnswers()
+{
+    for (KnownKey const& known : KnownKeys)
+    {
+        uint8 key[32];
+        memcpy(key, known.key, sizeof(key));
+
+        // The whole keystream in one call, past the end of the first block
+        RC4 whole(key, known.length);
+        std::vector<uint8> keystream = Keystream(whole, 4096 + 16);
+
+        for (KnownAnswer const& answer : known.answers)
+            CHECK(!memcmp(&keystream[answer.offset], answer.keystream, 16));
+
+        // Skip to every offset, Skip(1024) among them
+        for (KnownAnswer const& answer : known.answers)
+        {
+            RC4 skipped(key, known.length);
+            skipped.Skip(int32(answer.offset));
+            CHECK(Keystream(skipped, 16) == std::vector<uint8>(answer.keystream, answer.keystream + 16));
+        }
+
+        // Reinitializing drops whatever the previous key left buffered
+        RC4 reused(key, known.length);
+        reused.Skip(100);
+        reused.Initialize(key);
+        CHECK(!memcmp(Keystream(reused, 16).data(), known.answers[0].keystream, 16));
+    }
+}
+
+static void TestBlockBoundaries(std::mt19937& random)
+{
+    uint32 const block = RC4::KEYSTREAM_SIZE;
+
+    // Reads that end right before, on and after the end of a block, then read across it
+    uint32 const splits[] = { 1, 15, 16, block - 1, block, block + 1, 2 * block - 1, 2 * block, 2 * block + 1 };
+
+    for (uint32 split : splits)
+    {
+        uint8 key[20];
+        for (uint8& byte : key)
+            byte = uint8(random());
+
+        ReferenceRC4 reference(key, sizeof(key));
+        std::vector<uint8> expected(3 * block);
+        for (uint8& byte : expected)
+            byte = reference.Next();
+
+        RC4 updated(key, sizeof(key));
+        std::vector<uint8> first = Keystream(updated, split);
+        std::vector<uint8> second = Keystream(updated, expected.size() - split);
+        first.insert(first.end(), second.begin(), second.end());
+        CHECK(first == expected);
+
+        RC4 skipped(key, sizeof(key));
+        skipped.Skip(int32(split));
+        CHECK(Keystream(skipped, 64) == std::vector<uint8>(expected.begin() + split, expected.begin() + split + 64));
+    }
+
+    // Random mixes of Update and Skip, as packet headers and drop-N use them
+    for (uint32 round = 0; round < 200; ++round)
+    {
+        uint8 key[20];
+        for (uint8& byte : key)
+            byte = uint8(random());
+
+        ReferenceRC4 reference(key, sizeof(key));
+        RC4 cipher(key, sizeof(key));
+
+        for (uint32 step = 0; step < 64; ++step)
+        {
+            uint32 length = random() % 8 ? random() % 64 : random() % (2 * block);
+
+            if (random() % 4)
+            {
+                std::vector<uint8> expected(length);
+                for (uint8& byte : expected)
+                    byte = reference.Next();
+
+                CHECK(Keystream(cipher, length) == expected);
+            }
+            else
+            {
+                for (uint32 i = 0; i < length; ++i)
+                    reference.Next();
+
+                cipher.Skip(int32(length));
+            }
+        }
+    }
+}
+
+// Refill only generates ahead, whatever list of ciphers it is handed the keystream
+// must stay the same. Sockets can show up twice in a reactor batch, so the lists
+// repeat ciphers as well.
+static void TestRefill(std::mt19937& random)
+{
+    uint32 const block = RC4::KEYSTREAM_SIZE;
+
+    for (uint32 round = 0; round < 500; ++round)
+    {
+        uint32 count = random() % 4 + 1;
+        std::vector<std::vector<uint8>> keys(count, std::vector<uint8>(20));
+        std::vector<std::unique_ptr<RC4>> ciphers;
+        std::vector<ReferenceRC4> references;
+
+        for (uint32 i = 0; i < count; ++i)
+        {
+            for (uint8& byte : keys[i])
+                byte = uint8(random());
+
+            ciphers.emplace_back(new RC4(keys[i].data(), int32(keys[i].size())));
+            references.emplace_back(keys[i].data(), keys[i].size());
+
+            // Nothing buffered, running low, or plenty left
+            uint32 const consumed[] = { 0, block - 100, 1 };
+            uint32 length = consumed[random() % 3];
+
+            std::vector<uint8> expected(length);
+            for (uint8& byte : expected)
+                byte = references[i].Next();
+
+            CHECK(Keystream(*ciphers[i], length) == expected);
+        }
+
+        for (uint32 pass = 0; pass < 3; ++pass)
+        {
+            std::vector<RC4*> list;
+            uint32 size = random() % 8;
+
+            for (uint32 i = 0; i < size; ++i)
+                list.push_back(ciphers[random() % count].get());
+
+            RC4::Refill(list.data(), list.size());
+
+            for (uint32 i = 0; i < count; ++i)
+            {
+                uint32 length = random() % (block / 2);
+
+                std::vector<uint8> expected(length);
+                for (uint8& byte : expected)
+                    byte = references[i].Next();
+
+                CHECK(Keystream(*ciphers[i], length) == expected);
+            }
+        }
+    }
+
+    // Decrypt and encrypt cipher of one socket listed twice, only the second one low
+    uint8 key[20] = { };
+    RC4 decrypt(key, sizeof(key)), encrypt(key, sizeof(key));
+    ReferenceRC4 decryptReference(key, sizeof(key)), encryptReference(key, sizeof(key));
+
+    Keystream(decrypt, 1);
+    decryptReference.Next();
+
+    RC4* list[] = { &decrypt, &encrypt, &decrypt, &encrypt };
+    RC4::Refill(list, 4);
+
+    std::vector<uint8> decrypted = Keystream(decrypt, 2 * block);
+    std::vector<uint8> encrypted = Keystream(encrypt, 2 * block);
+
+    for (uint32 i = 0; i < 2 * block; ++i)
+    {
+        CHECK(decrypted[i] == decryptReference.Next());
+        CHECK(encrypted[i] == encryptReference.Next());
+    }
+}
+
+int main()
+{
+    std::mt19937 random(0x21);
+
+    TestKnownAnswers();
+    TestBlockBoundaries(random);
+    TestRefill(random);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Benchmark.h"
+#include "BigNumber.h"
+#include <random>
+#include <vector>
+
+// g ^ x mod N the way SRP6 computed it before and after the generator table,
+// for exponents of the 20 byte SHA1 digest size used by the login
+static uint8 const Modulus[32] =
+{
+    0xB7, 0x9B, 0x3E, 0x2A, 0x87, 0x82, 0x3C, 0xAB, 0x8F, 0x5E, 0xBF, 0xBF, 0x8E, 0xB1, 0x01, 0x08,
+    0x53, 0x50, 0x06, 0x29, 0x8B, 0x5B, 0xAD, 0xBD, 0x5B, 0x53, 0xE1, 0x89, 0x5E, 0x64, 0x4B, 0x89
+};
+
+int main()
+{
+    BigNumber N(Modulus, sizeof(Modulus));
+    BigNumber g(7);
+
+    std::mt19937 random(0x24);
+    std::vector<BigNumber> exponents(64);
+
+    for (BigNumber& exponent : exponents)
+    {
+        uint8 bytes[20];
+
+        for (uint8& byte : bytes)
+            byte = uint8(random());
+
+        exponent.SetBinary(bytes, sizeof(bytes));
+    }
+
+    uint32 const iterations = 20000;
+    uint32 next = 0;
+
+    Benchmark("BigNumber::ModExp", iterations, [&]()
+    {
+        BigNumber result = g.ModExp(exponents[next++ % exponents.size()], N);
+        BENCHMARK_KEEP(result.GetNumBytes());
+    });
+
+    BigNumberContext context;
+    context.SetModulus(N);
+    BigNumber result;
+
+    Benchmark("BigNumberContext::ModExp", iterations, [&]()
+    {
+        context.ModExp(result, g, exponents[next++ % exponents.size()]);
+        BENCHMARK_KEEP(result.GetNumBytes());
+    });
+
+    Benchmark("FixedBaseTable construction", 20, [&]()
+    {
+        FixedBaseTable table(g, N, 20);
+        BENCHMARK_KEEP(table.Matches(g, N));
+    });
+
+    FixedBaseTable table(g, N, 20);
+
+    Benchmark("FixedBaseTable::ModExp", iterations, [&]()
+    {
+        table.ModExp(result, exponents[next++ % exponents.size()], context);
+        BENCHMARK_KEEP(result.GetNumBytes());
+    });
+
+    return 0;
+}
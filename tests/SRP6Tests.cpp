@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Test.h"
+#include "SRP6.h"
+#include <random>
+
+// SRP6::Calculate against the original implementation, kept below as the reference,
+// with the server side played by the test itself. The secrets are fixed, so every
+// run covers the same short values.
+
+static uint8 const Modulus[32] =
+{
+    0xB7, 0x9B, 0x3E, 0x2A, 0x87, 0x82, 0x3C, 0xAB, 0x8F, 0x5E, 0xBF, 0xBF, 0x8E, 0xB1, 0x01, 0x08,
+    0x53, 0x50, 0x06, 0x29, 0x8B, 0x5B, 0xAD, 0xBD, 0x5B, 0x53, 0xE1, 0x89, 0x5E, 0x64, 0x4B, 0x89
+};
+
+static uint8 const Generator[1] = { 7 };
+
+static uint8 const Salt[32] =
+{
+    0x0B, 0x30, 0x55, 0x7A, 0x9F, 0xC4, 0xE9, 0x0E, 0x33, 0x58, 0x7D, 0xA2, 0xC7, 0xEC, 0x11, 0x36,
+    0x5B, 0x80, 0xA5, 0xCA, 0xEF, 0x14, 0x39, 0x5E, 0x83, 0xA8, 0xCD, 0xF2, 0x17, 0x3C, 0x61, 0x86
+};
+
+static uint8 const ServerSecret[19] =
+{
+    0x05, 0x60, 0xBB, 0x16, 0x71, 0xCC, 0x27, 0x82, 0xDD, 0x38, 0x93, 0xEE, 0x49, 0xA4, 0xFF, 0x5A,
+    0xB5, 0x10, 0x6B
+};
+
+struct Login
+{
+    char const* description;
+    uint8 clientSecret[19];
+    int32 numBytesS;
+    int32 numBytesA;
+};
+
+// Little endian, like everything on the wire
+static Login const Logins[] =
+{
+    {
+        "full length S",
+        { 0x40, 0xB2, 0x5E, 0xAC, 0x43, 0x82, 0x60, 0xC9, 0xAD, 0x4E, 0x31, 0x42, 0xAD, 0xC3, 0x8A, 0x8D, 0x08, 0x85, 0xE5 },
+        32, 32
+    },
+    {
+        "S one byte short",
+        { 0x33, 0xFB, 0xF3, 0x74, 0x46, 0xEE, 0x6F, 0x9F, 0xEC, 0xF1, 0xA1, 0x3D, 0x28, 0x34, 0x13, 0x93, 0xC0, 0x36, 0x09 },
+        31, 32
+    },
+    {
+        "S two bytes short",
+        { 0xB2, 0x02, 0xCC, 0xB4, 0xCA, 0x3A, 0x71, 0x72, 0x5F, 0xAC, 0xED, 0xF1, 0xF7, 0x18, 0xC0, 0xAF, 0x84, 0x87, 0x5A },
+        30, 32
+    },
+    {
+        "A one byte short",
+        { 0xB6, 0x48, 0x56, 0x33, 0xF4, 0x90, 0x14, 0x43, 0x36, 0x0D, 0x61, 0x96, 0x7C, 0xA3, 0x07, 0xD7, 0x25, 0x7F, 0x7D },
+        32, 31
+    }
+};
+
+static char const* const AccountName = "PLAYER";
+static char const* const AccountPassword = "SECRET";
+
+struct Result
+{
+    BigNumber A, u, S, K, M1, M2;
+};
+
+// The original SRP6::Calculate. It read S.AsByteArray() past the end when S was short,
+// here the 32 bytes of S are laid out by hand instead.
+static Result CalculateReference(BigNumber N, BigNumber g, BigNumber s, BigNumber B, BigNumber a)
+{
+    Result result;
+    BigNumber k(3);
+
+    SHA1 hg;
+    hg.Update(g);
+    hg.Finalize();
+
+    SHA1 hN;
+    hN.Update(N);
+    hN.Finalize();
+
+    uint8 bI[20];
+
+    for (uint32 i = 0; i < 20; i++)
+        bI[i] = hg.GetDigest()[i] ^ hN.GetDigest()[i];
+
+    BigNumber I;
+    I.SetBinary(bI, 20);
+
+    SHA1 hCredentials;
+    hCredentials.Update(std::string(AccountName) + ":" + AccountPassword);
+    hCredentials.Finalize();
+
+    SHA1 hx;
+    hx.Update(s);
+    hx.Update(hCredentials.GetDigest(), hCredentials.GetDigestLength());
+    hx.Finalize();
+
+    BigNumber x;
+    x.SetBinary(hx.GetDigest(), hx.GetDigestLength());
+
+    result.A = g.ModExp(a, N);
+
+    SHA1 hu;
+    hu.Update(result.A);
+    hu.Update(B);
+    hu.Finalize();
+
+    result.u.SetBinary(hu.GetDigest(), hu.GetDigestLength());
+
+    result.S = ((B + k * (N - g.ModExp(x, N))) % N).ModExp(a + (result.u * x), N);
+
+    // Little endian and zero padded, independent of AsByteArray's padding
+    int32 numBytes = result.S.GetNumBytes();
+    std::unique_ptr<uint8[]> bigEndian = result.S.AsByteArray(0, false);
+    uint8 bS[32] = { };
+
+    for (int32 i = 0; i < numBytes; ++i)
+        bS[i] = bigEndian[numBytes - 1 - i];
+
+    uint8 SPart[2][16];
+
+    for (int i = 0; i < 16; i++)
+    {
+        SPart[0][i] = bS[i * 2];
+        SPart[1][i] = bS[i * 2 + 1];
+    }
+
+    SHA1 hEven;
+    hEven.Update(SPart[0], 16);
+    hEven.Finalize();
+
+    SHA1 hOdd;
+    hOdd.Update(SPart[1], 16);
+    hOdd.Finalize();
+
+    uint8 bK[40];
+
+    for (uint32 i = 0; i < 20; i++)
+    {
+        bK[i * 2] = hEven.GetDigest()[i];
+        bK[i * 2 + 1] = hOdd.GetDigest()[i];
+    }
+
+    result.K.SetBinary(bK, sizeof(bK));
+
+    SHA1 hUsername;
+    hUsername.Update(std::string(AccountName));
+    hUsername.Finalize();
+
+    SHA1 hM1;
+    hM1.Update(I);
+    hM1.Update(hUsername.GetDigest(), hUsername.GetDigestLength());
+    hM1.Update(s);
+    hM1.Update(result.A);
+    hM1.Update(B);
+    hM1.Update(result.K);
+    hM1.Finalize();
+
+    result.M1.SetBinary(hM1.GetDigest(), hM1.GetDigestLength());
+
+    SHA1 hM2;
+    hM2.Update(result.A);
+    hM2.Update(result.M1);
+    hM2.Update(result.K);
+    hM2.Finalize();
+
+    result.M2.SetBinary(hM2.GetDigest(), hM2.GetDigestLength());
+    return result;
+}
+
+// FixedBaseTable::ModExp against BigNumber::ModExp for exponents of every length
+// up to a few bytes past the table, which it has to refuse
+static void TestFixedBaseTable(BigNumber base, BigNumber N, int32 maxBytes, std::mt19937& random)
+{
+    FixedBaseTable table(base, N, maxBytes);
+    BigNumberContext context;
+    CHECK(table.Matches(base, N));
+
+    for (int32 length = 0; length <= maxBytes + 4; ++length)
+    {
+        for (uint32 round = 0; round < 20; ++round)
+        {
+            uint8 bytes[FixedBaseTable::MAX_BYTES + 4] = { };
+
+            for (int32 i = 0; i < length; ++i)
+                bytes[i] = uint8(random());
+
+            // Every other round keeps the top byte, so each length is hit exactly
+            if (length && round % 2)
+                bytes[length - 1] |= 0x80;
+
+            BigNumber exponent(bytes, length ? length : 1);
+            BigNumber result(12345);
+
+            if (exponent.GetNumBytes() > maxBytes)
+            {
+                CHECK(!table.ModExp(result, exponent, context));
+                CHECK(result == BigNumber(12345));
+                continue;
+            }
+
+            CHECK(table.ModExp(result, exponent, context));
+            CHECK(result == base.ModExp(exponent, N));
+        }
+    }
+}
+
+int main()
+{
+    BigNumber N(Modulus, sizeof(Modulus));
+    BigNumber g(Generator, sizeof(Generator));
+    BigNumber s(Salt, sizeof(Salt));
+    BigNumber b(ServerSecret, sizeof(ServerSecret));
+    BigNumber k(3);
+
+    // Server: v = g ^ H(s, H(C, ":", P)), B = k * v + g ^ b
+    SHA1 hCredentials;
+    hCredentials.Update(std::string(AccountName) + ":" + AccountPassword);
+    hCredentials.Finalize();
+
+    SHA1 hx;
+    hx.Update(s);
+    hx.Update(hCredentials.GetDigest(), hCredentials.GetDigestLength());
+    hx.Finalize();
+
+    BigNumber x(hx.GetDigest(), hx.GetDigestLength());
+    BigNumber v = g.ModExp(x, N);
+    BigNumber B = (k * v + g.ModExp(b, N)) % N;
+
+    std::unique_ptr<uint8[]> bB = B.AsByteArray(32);
+
+    // One instance for every login, as AuthSession keeps it across reconnects
+    SRP6 srp6;
+
+    for (Login const& login : Logins)
+    {
+        testContext = login.description;
+
+        BigNumber a(login.clientSecret, sizeof(login.clientSecret));
+        Result expected = CalculateReference(N, g, s, B, a);
+
+        // The fixed secrets still hit the short cases they are named after
+        CHECK(expected.S.GetNumBytes() == login.numBytesS);
+        CHECK(expected.A.GetNumBytes() == login.numBytesA);
+
+        // The reference agrees with the server: S = (A * v ^ u) ^ b
+        CHECK(((expected.A * v.ModExp(expected.u, N)) % N).ModExp(b, N) == expected.S);
+
+        srp6.Reset();
+        srp6.SetCredentials(AccountName, AccountPassword);
+        srp6.SetServerModulus(Modulus, sizeof(Modulus));
+        srp6.SetServerGenerator(Generator, sizeof(Generator));
+        srp6.SetServerEphemeralB(bB.get(), 32);
+        srp6.SetServerSalt(Salt, sizeof(Salt));
+        srp6.SetClientSecret(login.clientSecret, sizeof(login.clientSecret));
+        srp6.Calculate();
+
+        CHECK(*srp6.GetClientEphemeralA() == expected.A);
+        CHECK(*srp6.GetClientK() == expected.K);
+        CHECK(*srp6.GetClientM1() == expected.M1);
+
+        std::unique_ptr<uint8[]> bM2 = expected.M2.AsByteArray(20);
+        CHECK(srp6.IsValidM2(bM2.get(), 20));
+    }
+
+    testContext = nullptr;
+
+    std::mt19937 random(0x24);
+
+    // 20 bytes is what SRP6 builds its generator table for
+    TestFixedBaseTable(g, N, 20, random);
+    TestFixedBaseTable(s, N, 20, random);
+    TestFixedBaseTable(g, N, 32, random);
+
+    return TEST_RESULT();
+}
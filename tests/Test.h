@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2015 Dehravor <dehravor@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Define.h"
+#include <cstdio>
+
+// Checks for the test executables: a failed check is printed and counted, the
+// test keeps going so one run reports every mismatch. A test looping over cases
+// points testContext at the current one so failures say which case it was
+static uint32 testFailures = 0;
+static char const* testContext = nullptr;
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            if (testContext) \
+                printf("%s:%d: CHECK(%s) failed for %s\n", __FILE__, __LINE__, #condition, testContext); \
+            else \
+                printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++testFailures; \
+        } \
+    } while (0)
+
+#define TEST_RESULT() (testFailures ? 1 : 0)